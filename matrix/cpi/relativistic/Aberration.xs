@@ -0,0 +1,149 @@
+/*
+ * Perl bindings for the aberration / Doppler tables in gperlaberration.c.
+ *
+ * everything goes through the shared default table.  angles and speeds
+ * for the batch lookups are packed native doubles, as in Lorentz.xs, and
+ * come back the same way.
+ */
+
+#include "gperl.h"
+#include "gperl_aberration.h"
+
+static gdouble *
+packed_doubles (SV * sv, gsize * n, const char * what)
+{
+	STRLEN len;
+	char * buf = SvPVbyte (sv, len);
+	if (len % sizeof (gdouble))
+		croak ("%s is not a packed array of doubles (%" UVuf " bytes)",
+		       what, (UV) len);
+	*n = len / sizeof (gdouble);
+	return (gdouble *) buf;
+}
+
+static SV *
+new_packed_doubles (gsize n, gdouble ** data)
+{
+	SV * sv = newSV (n * sizeof (gdouble) + 1);
+	SvPOK_on (sv);
+	SvCUR_set (sv, n * sizeof (gdouble));
+	*data = (gdouble *) SvPVX (sv);
+	return sv;
+}
+
+MODULE = Relativistic::Aberration	PACKAGE = Relativistic::Aberration
+
+=for object Relativistic::Aberration Table-driven aberration and Doppler factor
+
+=cut
+
+=for apidoc lookup
+
+=for signature (theta, doppler) = Relativistic::Aberration->lookup ($beta, $theta0)
+
+Like I<exact>, but interpolated from the default table.  Gives NaN for
+both when I<beta> is not below 1 in magnitude or either argument is NaN.
+
+=cut
+
+=for apidoc
+
+=for signature (theta, doppler) = Relativistic::Aberration->exact ($beta, $theta0)
+
+The observed polar angle and the Doppler factor f_observed / f_emitted
+for light emitted at I<theta0> in the rest frame of a source moving with
+speed I<beta> (in units of c) along x.
+
+=cut
+void
+exact (class, beta, theta0)
+	double beta
+	double theta0
+    ALIAS:
+	lookup = 1
+    PREINIT:
+	gdouble theta, doppler;
+    PPCODE:
+	if (ix == 1)
+		perl_aberration_lookup (perl_aberration_table_default (),
+		                         beta, theta0, &theta, &doppler);
+	else
+		perl_aberration_exact (beta, theta0, &theta, &doppler);
+	EXTEND (SP, 2);
+	PUSHs (sv_2mortal (newSVnv (theta)));
+	PUSHs (sv_2mortal (newSVnv (doppler)));
+
+=for apidoc
+
+=for signature (theta, doppler) = Relativistic::Aberration->lookup_angles ($beta, $theta0)
+
+Looks up every angle in the packed array I<theta0> at the one speed
+I<beta>, the starfield case.  Returns packed arrays.
+
+=cut
+void
+lookup_angles (class, beta, theta0)
+	double beta
+	SV * theta0
+    PREINIT:
+	gdouble * pt0, * theta, * doppler;
+	SV * theta_sv, * doppler_sv;
+	gsize n;
+    PPCODE:
+	pt0 = packed_doubles (theta0, &n, "theta0");
+	theta_sv = sv_2mortal (new_packed_doubles (n, &theta));
+	doppler_sv = sv_2mortal (new_packed_doubles (n, &doppler));
+	perl_aberration_lookup_angles (perl_aberration_table_default (),
+	                                beta, pt0, theta, doppler, n);
+	EXTEND (SP, 2);
+	PUSHs (theta_sv);
+	PUSHs (doppler_sv);
+
+=for apidoc
+
+=for signature (theta, doppler) = Relativistic::Aberration->lookup_array ($beta, $theta0)
+
+Looks up each sample of the packed arrays I<beta> and I<theta0>, the
+spectrum case.  Neighbouring samples at the same speed are cheaper than
+samples whose speeds all differ.  Returns packed arrays.
+
+=cut
+void
+lookup_array (class, beta, theta0)
+	SV * beta
+	SV * theta0
+    PREINIT:
+	gdouble * pb, * pt0, * theta, * doppler;
+	SV * theta_sv, * doppler_sv;
+	gsize n, n_theta0;
+    PPCODE:
+	pb = packed_doubles (beta, &n, "beta");
+	pt0 = packed_doubles (theta0, &n_theta0, "theta0");
+	if (n_theta0 != n)
+		croak ("beta and theta0 must hold the same number of values");
+	theta_sv = sv_2mortal (new_packed_doubles (n, &theta));
+	doppler_sv = sv_2mortal (new_packed_doubles (n, &doppler));
+	perl_aberration_lookup_array (perl_aberration_table_default (),
+	                               pb, pt0, theta, doppler, n);
+	EXTEND (SP, 2);
+	PUSHs (theta_sv);
+	PUSHs (doppler_sv);
+
+=for apidoc
+
+=for signature (angle_error, doppler_error) = Relativistic::Aberration->error
+
+The default table's worst angle error in radians and relative Doppler
+factor error, as measured at the cell centres when it was built.
+
+=cut
+void
+error (class)
+    PREINIT:
+	gdouble angle_error, doppler_error;
+    PPCODE:
+	perl_aberration_table_get_error (perl_aberration_table_default (),
+	                                  &angle_error, &doppler_error);
+	EXTEND (SP, 2);
+	PUSHs (sv_2mortal (newSVnv (angle_error)));
+	PUSHs (sv_2mortal (newSVnv (doppler_error)));
@@ -0,0 +1,218 @@
+/*
+ * Perl access to the wrapper accounting in gperlaccounting.c.
+ */
+
+#include "gperl.h"
+#include "gperl_accounting.h"
+
+static const char * counters[] = {
+	"live", "bytes", "created", "destroyed", "pinned"
+};
+
+static HV *
+SvSnapshot (SV * sv)
+{
+	if (!perl_sv_is_ref (sv) || SvTYPE (SvRV (sv)) != SVt_PVHV)
+		croak ("expecting a snapshot from Glib::Accounting->snapshot");
+	return (HV *) SvRV (sv);
+}
+
+static HV *
+fetch_hv (pTHX_ HV * hv, SV * key)
+{
+	HE * he = hv ? hv_fetch_ent (hv, key, FALSE, 0) : NULL;
+	SV * sv = he ? HeVAL (he) : NULL;
+	return sv && SvROK (sv) && SvTYPE (SvRV (sv)) == SVt_PVHV
+	     ? (HV *) SvRV (sv) : NULL;
+}
+
+static IV
+fetch_iv (pTHX_ HV * hv, const char * key)
+{
+	SV ** svp = hv ? hv_fetch (hv, key, strlen (key), FALSE) : NULL;
+	return svp ? SvIV (*svp) : 0;
+}
+
+/* after - before for every key in either, leaving out the zeros. */
+static HV *
+diff_sites (pTHX_ HV * before, HV * after)
+{
+	HV * diff = newHV ();
+	HE * he;
+
+	if (after) {
+		hv_iterinit (after);
+		while ((he = hv_iternext (after))) {
+			SV * key = hv_iterkeysv (he);
+			HE * old = before ? hv_fetch_ent (before, key, FALSE, 0)
+			                  : NULL;
+			IV delta = SvIV (HeVAL (he)) - (old ? SvIV (HeVAL (old)) : 0);
+			if (delta)
+				hv_store_ent (diff, key, newSViv (delta), 0);
+		}
+	}
+	if (before) {
+		hv_iterinit (before);
+		while ((he = hv_iternext (before))) {
+			SV * key = hv_iterkeysv (he);
+			if (!after || !hv_exists_ent (after, key, 0))
+				hv_store_ent (diff, key,
+				              newSViv (-SvIV (HeVAL (he))), 0);
+		}
+	}
+	return diff;
+}
+
+/* NULL if nothing changed for this type. */
+static HV *
+diff_type (pTHX_ HV * before, HV * after)
+{
+	HV * diff = newHV (), * sites;
+	SV * key = sv_2mortal (newSVpvs ("sites"));
+	gboolean changed = FALSE;
+	guint i;
+
+	for (i = 0 ; i < G_N_ELEMENTS (counters) ; i++) {
+		IV delta = fetch_iv (aTHX_ after, counters[i])
+		         - fetch_iv (aTHX_ before, counters[i]);
+		changed |= delta != 0;
+		perl_hv_take_sv (diff, counters[i], strlen (counters[i]),
+		                  newSViv (delta));
+	}
+	sites = diff_sites (aTHX_ fetch_hv (aTHX_ before, key),
+	                    fetch_hv (aTHX_ after, key));
+	changed |= HvUSEDKEYS (sites) > 0;
+	perl_hv_take_sv_s (diff, "sites", newRV_noinc ((SV *) sites));
+
+	if (!changed) {
+		SvREFCNT_dec ((SV *) diff);
+		return NULL;
+	}
+	return diff;
+}
+
+MODULE = Glib::Accounting	PACKAGE = Glib::Accounting
+
+=for object Glib::Accounting Per-type wrapper accounting
+
+=cut
+
+=for apidoc
+
+=for signature Glib::Accounting->enable ($sample_every=64)
+
+Start counting wrappers.  One wrapper in I<sample_every> has the perl file
+and line that created it recorded; 0 records no call sites.
+
+=cut
+void
+enable (class, sample_every=64)
+	guint sample_every
+    CODE:
+	perl_wrapper_accounting_enable (sample_every);
+
+=for apidoc
+
+Stop counting and forget everything recorded so far.
+
+=cut
+void
+disable (class)
+    CODE:
+	perl_wrapper_accounting_disable ();
+
+gboolean
+is_enabled (class)
+    CODE:
+	RETVAL = perl_wrapper_accounting_is_enabled ();
+    OUTPUT:
+	RETVAL
+
+=for apidoc
+
+=for signature hashref = Glib::Accounting->snapshot
+
+The current counters, keyed by type name.  Each value is a hash with the
+keys live, bytes, created, destroyed, pinned and sites; sites maps
+"file:line" to the number of sampled wrappers created there that are
+still alive.
+
+=cut
+SV *
+snapshot (class)
+    PREINIT:
+	GPerlWrapperStats * stats;
+	GHashTableIter iter;
+	gpointer site, count;
+	HV * hv;
+	guint i, n;
+    CODE:
+	stats = perl_wrapper_accounting_snapshot (&n);
+	hv = newHV ();
+	for (i = 0 ; i < n ; i++) {
+		HV * entry = newHV (), * sites = newHV ();
+		const char * name = g_type_name (stats[i].type);
+
+		perl_hv_take_sv_s (entry, "live", newSViv (stats[i].n_live));
+		perl_hv_take_sv_s (entry, "bytes", newSViv (stats[i].bytes));
+		perl_hv_take_sv_s (entry, "created", newSVuv (stats[i].n_created));
+		perl_hv_take_sv_s (entry, "destroyed", newSVuv (stats[i].n_destroyed));
+		perl_hv_take_sv_s (entry, "pinned", newSViv (stats[i].n_pinned));
+
+		g_hash_table_iter_init (&iter, stats[i].sites);
+		while (g_hash_table_iter_next (&iter, &site, &count))
+			perl_hv_take_sv (sites, site, strlen (site),
+			                  newSVuv (GPOINTER_TO_UINT (count)));
+		perl_hv_take_sv_s (entry, "sites", newRV_noinc ((SV *) sites));
+
+		perl_hv_take_sv (hv, name, strlen (name),
+		                  newRV_noinc ((SV *) entry));
+	}
+	perl_wrapper_accounting_snapshot_free (stats, n);
+	RETVAL = newRV_noinc ((SV *) hv);
+    OUTPUT:
+	RETVAL
+
+=for apidoc
+
+=for signature hashref = Glib::Accounting->diff ($before, $after)
+
+What changed between two snapshots: for every type whose counters moved,
+a hash of the same shape as in I<snapshot> holding I<after> minus
+I<before>, with unchanged call sites left out.  A type whose live count
+keeps growing from one diff to the next is the one to look at.
+
+=cut
+SV *
+diff (class, before, after)
+	SV * before
+	SV * after
+    PREINIT:
+	HV * old, * new, * hv;
+	HE * he;
+    CODE:
+	old = SvSnapshot (before);
+	new = SvSnapshot (after);
+	hv = newHV ();
+
+	hv_iterinit (new);
+	while ((he = hv_iternext (new))) {
+		SV * key = hv_iterkeysv (he);
+		HV * type = diff_type (aTHX_ fetch_hv (aTHX_ old, key),
+		                       fetch_hv (aTHX_ new, key));
+		if (type)
+			hv_store_ent (hv, key, newRV_noinc ((SV *) type), 0);
+	}
+	hv_iterinit (old);
+	while ((he = hv_iternext (old))) {
+		SV * key = hv_iterkeysv (he);
+		HV * type;
+		if (hv_exists_ent (new, key, 0))
+			continue;
+		type = diff_type (aTHX_ fetch_hv (aTHX_ old, key), NULL);
+		if (type)
+			hv_store_ent (hv, key, newRV_noinc ((SV *) type), 0);
+	}
+	RETVAL = newRV_noinc ((SV *) hv);
+    OUTPUT:
+	RETVAL
@@ -0,0 +1,48 @@
+/*
+ * Perl access to the boxed wrapper pool counters in gperlboxedpool.c.
+ */
+
+#include "gperl.h"
+#include "gperl_boxed_pool.h"
+
+MODULE = Glib::Boxed	PACKAGE = Glib::Boxed
+
+=for apidoc
+
+=for signature hashref = Glib::Boxed->pool_stats
+
+Per-type allocation counters for boxed types registered with the pooled
+wrapper class, keyed by package name.  Each value is a hash with the keys
+wraps, reused, copies, borrowed, deferred, live and free.
+
+=cut
+SV *
+pool_stats (class)
+    PREINIT:
+	GType * types;
+	GPerlBoxedPoolStats * stats;
+	HV * hv;
+	guint i, n;
+    CODE:
+	n = perl_boxed_pool_get_stats (&types, &stats);
+	hv = newHV ();
+	for (i = 0 ; i < n ; i++) {
+		HV * entry = newHV ();
+		const char * package = perl_boxed_package_from_type (types[i]);
+		if (!package)
+			package = g_type_name (types[i]);
+		perl_hv_take_sv_s (entry, "wraps", newSVuv (stats[i].n_wraps));
+		perl_hv_take_sv_s (entry, "reused", newSVuv (stats[i].n_reused));
+		perl_hv_take_sv_s (entry, "copies", newSVuv (stats[i].n_copies));
+		perl_hv_take_sv_s (entry, "borrowed", newSVuv (stats[i].n_borrowed));
+		perl_hv_take_sv_s (entry, "deferred", newSVuv (stats[i].n_deferred));
+		perl_hv_take_sv_s (entry, "live", newSVuv (stats[i].n_live));
+		perl_hv_take_sv_s (entry, "free", newSVuv (stats[i].n_free));
+		perl_hv_take_sv (hv, package, strlen (package),
+		                  newRV_noinc ((SV *) entry));
+	}
+	g_free (types);
+	g_free (stats);
+	RETVAL = newRV_noinc ((SV *) hv);
+    OUTPUT:
+	RETVAL
@@ -0,0 +1,128 @@
+/*
+ * batched property access for Glib::Object, on top of gperlproperties.c.
+ */
+
+#include "gperl.h"
+#include "gperl_properties.h"
+
+static GParamSpec *
+find_property_or_croak (GObject * object, SV * name, gboolean writable)
+{
+	const char * str = SvGChar (name);
+	GParamSpec * pspec = perl_object_find_property (G_OBJECT_TYPE (object),
+	                                                 str);
+	if (!pspec)
+		croak ("type %s does not support property '%s'",
+		       G_OBJECT_TYPE_NAME (object), str);
+	if (writable ? !(pspec->flags & G_PARAM_WRITABLE)
+	             : !(pspec->flags & G_PARAM_READABLE))
+		croak ("property '%s' of type %s is not %s", str,
+		       G_OBJECT_TYPE_NAME (object),
+		       writable ? "writable" : "readable");
+	return pspec;
+}
+
+typedef struct {
+	GValue * values;
+	guint    n;
+} ScopedValues;
+
+static void
+unset_values (pTHX_ void * data)
+{
+	ScopedValues * scoped = data;
+	guint i;
+	for (i = 0 ; i < scoped->n ; i++)
+		if (G_IS_VALUE (&scoped->values[i]))
+			g_value_unset (&scoped->values[i]);
+}
+
+/* n zeroed GValues that get unset when the current scope is left, whether
+ * normally or by a croak halfway through filling them in. */
+static GValue *
+scoped_values_new (pTHX_ guint n)
+{
+	ScopedValues * scoped = perl_alloc_temp (sizeof (ScopedValues));
+	scoped->values = perl_alloc_temp (n * sizeof (GValue));
+	scoped->n = n;
+	SAVEDESTRUCTOR_X (unset_values, scoped);
+	return scoped->values;
+}
+
+/* perl_sv_from_value only wraps a boxed value, and the GValue holding it
+ * is unset before the caller sees the result, so boxed values get a copy
+ * of their own, as Glib::Object::get_property gives them. */
+static SV *
+sv_from_value_copy (const GValue * value)
+{
+	gpointer boxed;
+	if (G_TYPE_FUNDAMENTAL (G_VALUE_TYPE (value)) != G_TYPE_BOXED)
+		return perl_sv_from_value (value);
+	boxed = g_value_get_boxed (value);
+	if (!boxed)
+		return &PL_sv_undef;
+	return perl_new_boxed_copy (boxed, G_VALUE_TYPE (value));
+}
+
+MODULE = Glib::Object	PACKAGE = Glib::Object
+
+=for apidoc
+
+=for signature list = $object->get_properties (name, ...)
+
+Fetch several properties at once.  Property names are resolved through a
+per-class cache, so repeated calls on objects of the same class skip the
+class lookup.
+
+=cut
+void
+get_properties (object, ...)
+	GObject * object
+    PREINIT:
+	GParamSpec ** pspecs;
+	GValue * values;
+	guint i, n;
+    PPCODE:
+	n = items - 1;
+	/* mortal scratch space; perl frees it with the other temps. */
+	pspecs = perl_alloc_temp (n * sizeof (GParamSpec *));
+	for (i = 0 ; i < n ; i++)
+		pspecs[i] = find_property_or_croak (object, ST (1 + i), FALSE);
+	ENTER;
+	values = scoped_values_new (aTHX_ n);
+	perl_object_get_properties (object, n, pspecs, values);
+	EXTEND (SP, n);
+	for (i = 0 ; i < n ; i++)
+		PUSHs (sv_2mortal (sv_from_value_copy (&values[i])));
+	LEAVE;
+
+=for apidoc
+
+=for signature $object->set_properties (name => value, ...)
+
+Set several properties at once.  All values are converted before any of
+them is applied, and notify is frozen for the whole batch.
+
+=cut
+void
+set_properties (object, ...)
+	GObject * object
+    PREINIT:
+	GParamSpec ** pspecs;
+	GValue * values;
+	guint i, n;
+    CODE:
+	if (0 != ((items - 1) % 2))
+		croak ("set_properties expects name => value pairs "
+		       "(odd number of arguments detected)");
+	n = (items - 1) / 2;
+	pspecs = perl_alloc_temp (n * sizeof (GParamSpec *));
+	ENTER;
+	values = scoped_values_new (aTHX_ n);
+	for (i = 0 ; i < n ; i++) {
+		pspecs[i] = find_property_or_croak (object, ST (1 + 2 * i), TRUE);
+		g_value_init (&values[i], G_PARAM_SPEC_VALUE_TYPE (pspecs[i]));
+		perl_value_from_sv (&values[i], ST (2 + 2 * i));
+	}
+	perl_object_set_properties (object, n, pspecs, values);
+	LEAVE;
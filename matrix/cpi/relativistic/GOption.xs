@@ -0,0 +1,33 @@
+/*
+ * Glib::OptionContext parsing over the zero-copy @ARGV bridge in
+ * gperlargv.c.
+ */
+
+#include "gperl.h"
+#include "gperl_argv.h"
+
+MODULE = Glib::Option	PACKAGE = Glib::OptionContext	PREFIX = g_option_context_
+
+#if GLIB_CHECK_VERSION (2, 6, 0)
+
+=for apidoc
+
+Parse the options in @ARGV with this context and its groups, leaving the
+remaining arguments in @ARGV; croaks with the GError if parsing fails.
+The arguments are not copied on the way in, and the ones that survive
+parsing go back into @ARGV as the same scalars.
+
+=cut
+gboolean
+g_option_context_parse (context)
+	GOptionContext * context
+    PREINIT:
+	GError * error = NULL;
+    CODE:
+	RETVAL = perl_option_context_parse (context, &error);
+	if (!RETVAL)
+		perl_croak_mirror (NULL, error);
+    OUTPUT:
+	RETVAL
+
+#endif /* 2.6.0 */
@@ -0,0 +1,120 @@
+/*
+ * Perl bindings for the packed 64 bit integer converters in gperlint64.c.
+ */
+
+#include "gperl.h"
+#include "gperl_int64.h"
+
+static AV *
+SvArrayRef (SV * sv)
+{
+	if (!perl_sv_is_ref (sv) || SvTYPE (SvRV (sv)) != SVt_PVAV)
+		croak ("expecting a reference to an array of integers");
+	return (AV *) SvRV (sv);
+}
+
+static SV *
+pack_av (AV * av, gboolean is_unsigned, gboolean big_endian)
+{
+	gsize n = av_len (av) + 1;
+	guint64 * values = perl_alloc_temp (n * sizeof (guint64));
+	SV * sv;
+
+	if (is_unsigned)
+		perl_uint64_array_from_av (av, values, n);
+	else
+		perl_int64_array_from_av (av, (gint64 *) values, n);
+
+	sv = newSV (8 * n + 1);
+	SvPOK_only (sv);
+	perl_int64_array_pack (values, n, big_endian, (guchar *) SvPVX (sv));
+	SvCUR_set (sv, 8 * n);
+	*SvEND (sv) = '\0';
+	return sv;
+}
+
+static AV *
+unpack_sv (SV * data, gboolean is_unsigned, gboolean big_endian)
+{
+	STRLEN len;
+	const char * bytes = SvPVbyte (data, len);
+	gsize n = len / 8;
+	guint64 * values;
+
+	if (len % 8)
+		croak ("packed data length %" UVuf " is not a multiple of 8",
+		       (UV) len);
+	values = perl_alloc_temp (n * sizeof (guint64));
+	perl_int64_array_unpack ((const guchar *) bytes, n, big_endian, values);
+
+	return is_unsigned
+	     ? perl_uint64_array_to_av (values, n)
+	     : perl_int64_array_to_av ((const gint64 *) values, n);
+}
+
+MODULE = Glib::Int64	PACKAGE = Glib::Int64
+
+=for object Glib::Int64 Packed 64 bit integer columns
+
+=cut
+
+=for apidoc
+
+=for signature string = Glib::Int64->pack ($arrayref, $big_endian=FALSE)
+
+Pack an array of signed 64 bit integers into a string of 8 byte words,
+little-endian unless I<big_endian> is true.
+
+=cut
+SV *
+pack (class, values, big_endian=FALSE)
+	SV * values
+	gboolean big_endian
+    CODE:
+	RETVAL = pack_av (SvArrayRef (values), FALSE, big_endian);
+    OUTPUT:
+	RETVAL
+
+=for apidoc
+
+=for signature arrayref = Glib::Int64->unpack ($string, $big_endian=FALSE)
+
+The inverse of I<pack>.  Croaks unless the length of I<string> is a
+multiple of 8.
+
+=cut
+SV *
+unpack (class, data, big_endian=FALSE)
+	SV * data
+	gboolean big_endian
+    CODE:
+	RETVAL = newRV_noinc ((SV *) unpack_sv (data, FALSE, big_endian));
+    OUTPUT:
+	RETVAL
+
+MODULE = Glib::Int64	PACKAGE = Glib::UInt64
+
+=for apidoc
+
+=for signature string = Glib::UInt64->pack ($arrayref, $big_endian=FALSE)
+
+Like Glib::Int64->pack, for unsigned values; croaks on negative ones.
+
+=cut
+SV *
+pack (class, values, big_endian=FALSE)
+	SV * values
+	gboolean big_endian
+    CODE:
+	RETVAL = pack_av (SvArrayRef (values), TRUE, big_endian);
+    OUTPUT:
+	RETVAL
+
+SV *
+unpack (class, data, big_endian=FALSE)
+	SV * data
+	gboolean big_endian
+    CODE:
+	RETVAL = newRV_noinc ((SV *) unpack_sv (data, TRUE, big_endian));
+    OUTPUT:
+	RETVAL
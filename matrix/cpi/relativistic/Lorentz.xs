@@ -0,0 +1,199 @@
+/*
+ * Perl bindings for the batched Lorentz kernels in gperllorentz.c.
+ *
+ * particle data crosses the boundary as packed native doubles, i.e. the
+ * strings produced by pack ("d*", ...) or read straight from a data file,
+ * so a million particles cost four string buffers rather than four million
+ * scalars.  transforms that map an array onto itself work in place.
+ */
+
+#include "gperl.h"
+#include "gperl_lorentz.h"
+
+/* inputs are only read, so they are not forced into plain strings; the
+ * arrays transformed in place are. */
+static gdouble *
+packed_doubles (SV * sv, gsize * n, const char * what, gboolean writable)
+{
+	STRLEN len;
+	char * buf = writable ? SvPVbyte_force (sv, len) : SvPVbyte (sv, len);
+	if (len % sizeof (gdouble))
+		croak ("%s is not a packed array of doubles (%" UVuf " bytes)",
+		       what, (UV) len);
+	*n = len / sizeof (gdouble);
+	return (gdouble *) buf;
+}
+
+static SV *
+new_packed_doubles (gsize n, gdouble ** data)
+{
+	SV * sv = newSV (n * sizeof (gdouble) + 1);
+	SvPOK_on (sv);
+	SvCUR_set (sv, n * sizeof (gdouble));
+	*data = (gdouble *) SvPVX (sv);
+	return sv;
+}
+
+static void
+check_speed (gdouble bx, gdouble by, gdouble bz)
+{
+	if (!(bx * bx + by * by + bz * bz < 1.0))
+		croak ("frame velocity (%g, %g, %g) is not below the speed of light",
+		       bx, by, bz);
+}
+
+static void
+check_distinct (SV * a, SV * b, SV * c, SV * d, const char * what)
+{
+	if (a == b || a == c || b == c || (d && (a == d || b == d || c == d)))
+		croak ("%s must be distinct scalars", what);
+}
+
+static const char * isa_names[] = { "scalar", "avx2", "avx512" };
+
+MODULE = Relativistic::Lorentz	PACKAGE = Relativistic::Lorentz	PREFIX = perl_lorentz_
+
+=for object Relativistic::Lorentz Batched Lorentz transforms
+
+=cut
+
+=for apidoc
+
+Returns the instruction set the kernels are using, one of "scalar", "avx2"
+or "avx512".  With an argument, forces that instruction set (or the best
+available one below it) first.  Every choice gives bit-identical results.
+
+=cut
+const char *
+isa (class, isa=NULL)
+	const char * isa
+    PREINIT:
+	guint i;
+    CODE:
+	if (isa) {
+		for (i = 0 ; i < G_N_ELEMENTS (isa_names) ; i++)
+			if (strEQ (isa, isa_names[i]))
+				break;
+		if (i == G_N_ELEMENTS (isa_names))
+			croak ("unknown instruction set '%s'", isa);
+		perl_lorentz_set_isa ((GPerlLorentzIsa) i);
+	}
+	RETVAL = isa_names[perl_lorentz_get_isa ()];
+    OUTPUT:
+	RETVAL
+
+=for apidoc
+
+Boosts the packed 4-vector components I<t>, I<x>, I<y>, I<z> in place into
+the frame moving with velocity (I<bx>, I<by>, I<bz>), in units of c.
+
+=cut
+void
+boost (class, t, x, y, z, bx, by, bz)
+	SV * t
+	SV * x
+	SV * y
+	SV * z
+	double bx
+	double by
+	double bz
+    PREINIT:
+	GPerlFourVectors v;
+	gsize nx, ny, nz;
+    CODE:
+	check_speed (bx, by, bz);
+	check_distinct (t, x, y, z, "t, x, y and z");
+	v.t = packed_doubles (t, &v.n, "t", TRUE);
+	v.x = packed_doubles (x, &nx, "x", TRUE);
+	v.y = packed_doubles (y, &ny, "y", TRUE);
+	v.z = packed_doubles (z, &nz, "z", TRUE);
+	if (nx != v.n || ny != v.n || nz != v.n)
+		croak ("t, x, y and z must hold the same number of values");
+	perl_lorentz_boost (&v, bx, by, bz);
+	SvSETMAGIC (t);
+	SvSETMAGIC (x);
+	SvSETMAGIC (y);
+	SvSETMAGIC (z);
+
+=for apidoc
+
+Returns the packed collinear sums (u + v) / (1 + uv) of the packed speeds
+I<u> and I<v>.
+
+=cut
+SV *
+velocity_add (class, u, v)
+	SV * u
+	SV * v
+    PREINIT:
+	gdouble * pu, * pv, * pw;
+	gsize nu, nv;
+    CODE:
+	pu = packed_doubles (u, &nu, "u", FALSE);
+	pv = packed_doubles (v, &nv, "v", FALSE);
+	if (nu != nv)
+		croak ("u and v must hold the same number of values");
+	RETVAL = new_packed_doubles (nu, &pw);
+	perl_lorentz_velocity_add (pu, pv, pw, nu);
+    OUTPUT:
+	RETVAL
+
+=for apidoc
+
+Replaces the packed velocity components I<ux>, I<uy>, I<uz>, measured in a
+frame moving with (I<vx>, I<vy>, I<vz>), by the velocities seen from the
+rest frame.
+
+=cut
+void
+velocity_add_3 (class, ux, uy, uz, vx, vy, vz)
+	SV * ux
+	SV * uy
+	SV * uz
+	double vx
+	double vy
+	double vz
+    PREINIT:
+	gdouble * px, * py, * pz;
+	gsize nx, ny, nz;
+    CODE:
+	check_speed (vx, vy, vz);
+	check_distinct (ux, uy, uz, NULL, "ux, uy and uz");
+	px = packed_doubles (ux, &nx, "ux", TRUE);
+	py = packed_doubles (uy, &ny, "uy", TRUE);
+	pz = packed_doubles (uz, &nz, "uz", TRUE);
+	if (ny != nx || nz != nx)
+		croak ("ux, uy and uz must hold the same number of values");
+	perl_lorentz_velocity_add_3 (px, py, pz, nx, vx, vy, vz);
+	SvSETMAGIC (ux);
+	SvSETMAGIC (uy);
+	SvSETMAGIC (uz);
+
+=for apidoc rapidity
+
+Returns the packed rapidities atanh(beta) of the packed speeds I<beta>.
+
+=cut
+
+=for apidoc
+
+Returns the packed Lorentz factors of the packed speeds I<beta>.
+
+=cut
+SV *
+gamma (class, beta)
+	SV * beta
+    ALIAS:
+	rapidity = 1
+    PREINIT:
+	gdouble * pb, * out;
+	gsize n;
+    CODE:
+	pb = packed_doubles (beta, &n, "beta", FALSE);
+	RETVAL = new_packed_doubles (n, &out);
+	if (ix == 1)
+		perl_lorentz_rapidity (pb, out, n);
+	else
+		perl_lorentz_gamma (pb, out, n);
+    OUTPUT:
+	RETVAL
@@ -0,0 +1,111 @@
+/*
+ * Perl bindings for the photon reception-time sweep in gperlphotons.c.
+ */
+
+#include "gperl.h"
+#include "gperl_photons.h"
+
+static gdouble
+fetch_nv (HV * hv, const char * key, gdouble def)
+{
+	SV ** svp = hv_fetch (hv, key, strlen (key), FALSE);
+	return (svp && perl_sv_is_defined (*svp)) ? SvNV (*svp) : def;
+}
+
+/* counts and seeds are read as integers, so seeds keep all 64 bits; NaN,
+ * negative and too large values are refused rather than wrapped. */
+static guint64
+fetch_uv (HV * hv, const char * key, guint64 def, guint64 max)
+{
+	SV ** svp = hv_fetch (hv, key, strlen (key), FALSE);
+	NV nv;
+	UV uv;
+
+	if (!svp || !perl_sv_is_defined (*svp))
+		return def;
+	nv = SvNV (*svp);
+	if (!(nv >= 0.0) || nv >= 18446744073709551616.0)
+		croak ("%s must be a non-negative integer, not %" SVf,
+		       key, SVfARG (*svp));
+	uv = SvUV (*svp);
+	if (uv > max)
+		croak ("%s must be at most %" UVuf, key, (UV) max);
+	return uv;
+}
+
+MODULE = Relativistic::Photons	PACKAGE = Relativistic::Photons	PREFIX = perl_photon_
+
+=for object Relativistic::Photons Monte Carlo photon arrival-time sweeps
+
+=cut
+
+=for apidoc
+
+=for signature hashref = Relativistic::Photons->sweep (key => value, ...)
+
+Runs a sweep and returns a hash with I<bins> (an array of counts),
+I<underflow>, I<overflow>, I<events> and I<mean>.  Recognised keys are
+I<beta>, I<distance>, I<events>, I<seed>, I<threads>, I<events_per_task>,
+I<min>, I<max> and I<bins>.  The result depends only on the parameters,
+never on I<threads>.
+
+=cut
+SV *
+sweep (class, ...)
+    PREINIT:
+	GPerlPhotonSweep params;
+	GPerlPhotonHistogram histogram;
+	HV * args, * hv;
+	AV * bins;
+	guint i;
+    CODE:
+	if (!(items % 2))
+		croak ("usage: Relativistic::Photons->sweep (key => value, ...)");
+	args = (HV *) sv_2mortal ((SV *) newHV ());
+	for (i = 1 ; i < (guint) items ; i += 2)
+		hv_store_ent (args, ST (i), newSVsv (ST (i + 1)), 0);
+
+	params.beta = fetch_nv (args, "beta", 0.0);
+	params.distance = fetch_nv (args, "distance", 1e6);
+	params.n_events = fetch_uv (args, "events", 1000000, G_MAXUINT64);
+	params.seed = fetch_uv (args, "seed", 0, G_MAXUINT64);
+	params.n_threads = fetch_uv (args, "threads", 0, G_MAXUINT);
+	params.events_per_task = fetch_uv (args, "events_per_task", 0,
+	                                   G_MAXUINT64);
+	params.hist_min = fetch_nv (args, "min", 0.0);
+	params.hist_max = fetch_nv (args, "max", 2.0);
+	params.n_bins = fetch_uv (args, "bins", 100, G_MAXUINT);
+
+	if (!perl_photon_sweep_run (&params, &histogram))
+		croak ("invalid sweep parameters");
+
+	bins = newAV ();
+	av_extend (bins, histogram.n_bins - 1);
+	for (i = 0 ; i < histogram.n_bins ; i++)
+		av_push (bins, newSVnv ((NV) histogram.bins[i]));
+
+	hv = newHV ();
+	perl_hv_take_sv_s (hv, "bins", newRV_noinc ((SV *) bins));
+	perl_hv_take_sv_s (hv, "underflow", newSVnv ((NV) histogram.underflow));
+	perl_hv_take_sv_s (hv, "overflow", newSVnv ((NV) histogram.overflow));
+	perl_hv_take_sv_s (hv, "events", newSVnv ((NV) histogram.n_events));
+	perl_hv_take_sv_s (hv, "mean", newSVnv (histogram.mean));
+	perl_photon_histogram_clear (&histogram);
+
+	RETVAL = newRV_noinc ((SV *) hv);
+    OUTPUT:
+	RETVAL
+
+=for apidoc
+
+Reception-time difference, in units of the emission interval, for a single
+emission at I<cos_theta0> in the source frame.
+
+=cut
+double
+perl_photon_delay (class, beta, distance, cos_theta0)
+	double beta
+	double distance
+	double cos_theta0
+    C_ARGS:
+	beta, distance, cos_theta0
@@ -0,0 +1,126 @@
+/*
+ * Perl access to the default batching scheduler in gperlscheduler.c.
+ */
+
+#include "gperl.h"
+#include "gperl_scheduler.h"
+
+MODULE = Glib::Scheduler	PACKAGE = Glib::Scheduler
+
+#if GLIB_CHECK_VERSION (2, 28, 0)
+
+=for object Glib::Scheduler Batched idle and timeout callbacks
+
+=cut
+
+=for apidoc
+
+=for signature id = Glib::Scheduler->idle_add ($callback, $data=undef, $priority=G_PRIORITY_DEFAULT_IDLE)
+
+Like Glib::Idle->add, but the callback runs in a batch with the other
+scheduled callbacks of the same priority.  Returns an id for I<remove>.
+
+=cut
+guint
+idle_add (class, callback, data=NULL, priority=G_PRIORITY_DEFAULT_IDLE)
+	SV * callback
+	SV * data
+	gint priority
+    CODE:
+	RETVAL = perl_scheduler_add (perl_scheduler_get_default (),
+	                             priority, 0, callback, data);
+    OUTPUT:
+	RETVAL
+
+=for apidoc
+
+=for signature id = Glib::Scheduler->timeout_add ($interval, $callback, $data=undef, $priority=G_PRIORITY_DEFAULT)
+
+Like Glib::Timeout->add, with I<interval> in milliseconds, but batched
+as for I<idle_add>.  An I<interval> of 0 is the same as I<idle_add>.
+
+=cut
+guint
+timeout_add (class, interval, callback, data=NULL, priority=G_PRIORITY_DEFAULT)
+	guint interval
+	SV * callback
+	SV * data
+	gint priority
+    CODE:
+	RETVAL = perl_scheduler_add (perl_scheduler_get_default (),
+	                             priority, interval, callback, data);
+    OUTPUT:
+	RETVAL
+
+=for apidoc
+
+Unschedule the callback with id I<id>, releasing it and its data right
+away as Glib::Source->remove would; returns false if it was not
+scheduled.
+
+=cut
+gboolean
+remove (class, id)
+	guint id
+    CODE:
+	RETVAL = perl_scheduler_remove (perl_scheduler_get_default (), id);
+    OUTPUT:
+	RETVAL
+
+=for apidoc
+
+=for signature Glib::Scheduler->set_budget ($usec)
+
+How long, in microseconds, a batch may keep starting callbacks before
+handing the rest to the next one.
+
+=cut
+void
+set_budget (class, usec)
+	gint64 usec
+    CODE:
+	perl_scheduler_set_budget (perl_scheduler_get_default (), usec);
+
+gint64
+get_budget (class)
+    CODE:
+	RETVAL = perl_scheduler_get_budget (perl_scheduler_get_default ());
+    OUTPUT:
+	RETVAL
+
+=for apidoc
+
+=for signature hashref = Glib::Scheduler->stats ($reset=FALSE)
+
+The scheduler's counters: batches, callbacks, deferred (due callbacks the
+budget pushed to a later batch), over_budget (batches cut short),
+pending, max_batch_usec, max_lateness_usec and mean_lateness_usec.  With
+I<reset>, everything but pending starts again from zero.
+
+=cut
+SV *
+stats (class, reset=FALSE)
+	gboolean reset
+    PREINIT:
+	GPerlSchedulerStats stats;
+	HV * hv;
+    CODE:
+	perl_scheduler_get_stats (perl_scheduler_get_default (),
+	                          &stats, reset);
+	hv = newHV ();
+	perl_hv_take_sv_s (hv, "batches", newSVuv (stats.n_batches));
+	perl_hv_take_sv_s (hv, "callbacks", newSVuv (stats.n_callbacks));
+	perl_hv_take_sv_s (hv, "deferred", newSVuv (stats.n_deferred));
+	perl_hv_take_sv_s (hv, "over_budget", newSVuv (stats.n_over_budget));
+	perl_hv_take_sv_s (hv, "pending", newSVuv (stats.n_pending));
+	perl_hv_take_sv_s (hv, "max_batch_usec", newSViv (stats.max_batch_usec));
+	perl_hv_take_sv_s (hv, "max_lateness_usec", newSViv (stats.max_lateness_usec));
+	perl_hv_take_sv_s (hv, "mean_lateness_usec",
+	                   newSVnv (stats.n_callbacks
+	                            ? (NV) stats.total_lateness_usec / stats.n_callbacks
+	                            : 0.0));
+	RETVAL = newRV_noinc ((SV *) hv);
+    OUTPUT:
+	RETVAL
+
+#endif /* 2.28.0 */
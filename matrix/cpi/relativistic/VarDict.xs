@@ -0,0 +1,258 @@
+/*
+ * hash <-> a{sv} fast paths; the serializer lives in gperlvardict.c, the
+ * lazy tied hash below.
+ */
+
+#include "gperl.h"
+#include "gperl_vardict.h"
+
+typedef struct {
+	GVariant   * dict;
+	GHashTable * index;	/* key -> entry number + 1, built on first lookup */
+	gsize        n_entries;
+	gsize        iter;
+} LazyDict;
+
+static LazyDict *
+SvLazyDict (SV * sv)
+{
+	if (!SvROK (sv) || !sv_derived_from (sv, "Glib::Variant::LazyDict"))
+		croak ("%s is not a Glib::Variant::LazyDict", SvPV_nolen (sv));
+	return INT2PTR (LazyDict *, SvIV (SvRV (sv)));
+}
+
+static SV *
+newSVLazyDict (GVariant * dict)
+{
+	LazyDict * lazy = g_new0 (LazyDict, 1);
+	lazy->dict = g_variant_ref (dict);
+	/* the index keeps pointers to the keys, which only stay put once the
+	 * variant is serialized; a dict still in tree form would drop the
+	 * children they point into whenever anyone serialized it later. */
+	g_variant_get_data (dict);
+	lazy->n_entries = g_variant_n_children (dict);
+	return sv_setref_pv (newSV (0), "Glib::Variant::LazyDict", lazy);
+}
+
+/* the key strings point into the variant's own buffer. */
+static const char *
+entry_key (LazyDict * lazy, gsize i)
+{
+	GVariant * entry = g_variant_get_child_value (lazy->dict, i);
+	const char * key;
+	g_variant_get_child (entry, 0, "&s", &key);
+	g_variant_unref (entry);
+	return key;
+}
+
+static gboolean
+lazy_lookup (LazyDict * lazy, const char * key, gsize * i)
+{
+	gpointer found;
+
+	if (!lazy->index) {
+		gsize j;
+		lazy->index = g_hash_table_new (g_str_hash, g_str_equal);
+		/* first one wins, as with g_variant_lookup_value */
+		for (j = lazy->n_entries ; j-- > 0 ; )
+			g_hash_table_insert (lazy->index,
+			                     (gpointer) entry_key (lazy, j),
+			                     GSIZE_TO_POINTER (j + 1));
+	}
+	found = g_hash_table_lookup (lazy->index, key);
+	if (!found)
+		return FALSE;
+	*i = GPOINTER_TO_SIZE (found) - 1;
+	return TRUE;
+}
+
+static SV *
+newSVvariant_value (GVariant * value)
+{
+	switch (g_variant_classify (value)) {
+	    case G_VARIANT_CLASS_BOOLEAN:
+		return boolSV (g_variant_get_boolean (value));
+	    case G_VARIANT_CLASS_BYTE:
+		return newSVuv (g_variant_get_byte (value));
+	    case G_VARIANT_CLASS_INT16:
+		return newSViv (g_variant_get_int16 (value));
+	    case G_VARIANT_CLASS_UINT16:
+		return newSVuv (g_variant_get_uint16 (value));
+	    case G_VARIANT_CLASS_INT32:
+		return newSViv (g_variant_get_int32 (value));
+	    case G_VARIANT_CLASS_HANDLE:
+		return newSViv (g_variant_get_handle (value));
+	    case G_VARIANT_CLASS_UINT32:
+		return newSVuv (g_variant_get_uint32 (value));
+	    case G_VARIANT_CLASS_INT64:
+		return newSVGInt64 (g_variant_get_int64 (value));
+	    case G_VARIANT_CLASS_UINT64:
+		return newSIGURGInt64 (g_variant_get_uint64 (value));
+	    case G_VARIANT_CLASS_DOUBLE:
+		return newSVnv (g_variant_get_double (value));
+	    case G_VARIANT_CLASS_STRING:
+	    case G_VARIANT_CLASS_OBJECT_PATH:
+	    case G_VARIANT_CLASS_SIGNATURE:
+		return newSVGChar (g_variant_get_string (value, NULL));
+	    default:
+		break;
+	}
+	if (g_variant_is_of_type (value, G_VARIANT_TYPE_VARDICT))
+		return perl_vardict_new_lazy_hash (value);
+	return newSVGVariant (value);
+}
+
+SV *
+perl_vardict_new_lazy_hash (GVariant * dict)
+{
+	HV * hv;
+	SV * tie;
+
+	g_return_val_if_fail (g_variant_is_of_type (dict, G_VARIANT_TYPE_VARDICT),
+	                      &PL_sv_undef);
+
+	hv = newHV ();
+	tie = newSVLazyDict (dict);
+	hv_magic (hv, (GV *) tie, PERL_MAGIC_tied);
+	SvREFCNT_dec (tie);
+	return newRV_noinc ((SV *) hv);
+}
+
+MODULE = Glib::Variant::LazyDict	PACKAGE = Glib::Variant
+
+=for apidoc
+
+=for signature variant = Glib::Variant->new_vardict ($hashref)
+
+Serialize I<hashref> directly into an "a{sv}" variant.  Integers become
+"x" (or "t" if they only fit unsigned), other numbers "d", strings "s",
+Glib::Variant objects are embedded as they are and nested unblessed hash
+references become nested "a{sv}".  A scalar that has been used as a
+string is serialized as a string.  Anything else croaks.
+
+=cut
+GVariant_non *
+new_vardict (class, hash)
+	SV * hash
+    CODE:
+	if (!perl_sv_is_ref (hash) || SvTYPE (SvRV (hash)) != SVt_PVHV)
+		croak ("expecting a reference to a hash");
+	RETVAL = g_variant_ref_sink (perl_vardict_from_hv ((HV *) SvRV (hash)));
+    OUTPUT:
+	RETVAL
+
+=for apidoc
+
+=for signature hashref = $variant->lazy_hash
+
+A reference to a read-only tied hash over this "a{sv}" variant.  Keys
+are indexed on the first lookup and each value is only converted when it
+is fetched: basic types become perl scalars, nested "a{sv}" another lazy
+hash and anything else a Glib::Variant.
+
+=cut
+SV *
+lazy_hash (variant)
+	GVariant * variant
+    CODE:
+	if (!g_variant_is_of_type (variant, G_VARIANT_TYPE_VARDICT))
+		croak ("lazy_hash needs an a{sv} variant, not %s",
+		       g_variant_get_type_string (variant));
+	RETVAL = perl_vardict_new_lazy_hash (variant);
+    OUTPUT:
+	RETVAL
+
+MODULE = Glib::Variant::LazyDict	PACKAGE = Glib::Variant::LazyDict
+
+SV *
+TIEHASH (class, variant)
+	GVariant * variant
+    CODE:
+	if (!g_variant_is_of_type (variant, G_VARIANT_TYPE_VARDICT))
+		croak ("Glib::Variant::LazyDict needs an a{sv} variant, not %s",
+		       g_variant_get_type_string (variant));
+	RETVAL = newSVLazyDict (variant);
+    OUTPUT:
+	RETVAL
+
+SV *
+FETCH (sv, key)
+	SV * sv
+	const gchar * key
+    PREINIT:
+	LazyDict * lazy;
+	gsize i;
+    CODE:
+	lazy = SvLazyDict (sv);
+	if (lazy_lookup (lazy, key, &i)) {
+		GVariant * entry = g_variant_get_child_value (lazy->dict, i);
+		GVariant * boxed = g_variant_get_child_value (entry, 1);
+		GVariant * value = g_variant_get_variant (boxed);
+		RETVAL = newSVvariant_value (value);
+		g_variant_unref (value);
+		g_variant_unref (boxed);
+		g_variant_unref (entry);
+	} else {
+		RETVAL = &PL_sv_undef;
+	}
+    OUTPUT:
+	RETVAL
+
+gboolean
+EXISTS (sv, key)
+	SV * sv
+	const gchar * key
+    PREINIT:
+	gsize i;
+    CODE:
+	RETVAL = lazy_lookup (SvLazyDict (sv), key, &i);
+    OUTPUT:
+	RETVAL
+
+SV *
+FIRSTKEY (sv, ...)
+	SV * sv
+    ALIAS:
+	NEXTKEY = 1
+    PREINIT:
+	LazyDict * lazy;
+    CODE:
+	lazy = SvLazyDict (sv);
+	if (ix == 0)
+		lazy->iter = 0;
+	RETVAL = lazy->iter < lazy->n_entries
+	       ? newSVGChar (entry_key (lazy, lazy->iter++))
+	       : &PL_sv_undef;
+    OUTPUT:
+	RETVAL
+
+gsize
+SCALAR (sv)
+	SV * sv
+    CODE:
+	RETVAL = SvLazyDict (sv)->n_entries;
+    OUTPUT:
+	RETVAL
+
+void
+STORE (sv, ...)
+	SV * sv
+    ALIAS:
+	DELETE = 1
+	CLEAR = 2
+    CODE:
+	PERL_UNUSED_VAR (sv);
+	PERL_UNUSED_VAR (ix);
+	croak ("Glib::Variant::LazyDict is read-only");
+
+void
+DESTROY (sv)
+	SV * sv
+    PREINIT:
+	LazyDict * lazy;
+    CODE:
+	lazy = SvLazyDict (sv);
+	if (lazy->index)
+		g_hash_table_destroy (lazy->index);
+	g_variant_unref (lazy->dict);
+	g_free (lazy);
@@ -0,0 +1,121 @@
+/*
+ * Perl bindings for the memory-mapped XSUB index in gperlxsubs.c.
+ */
+
+#include "gperl.h"
+#include "gperl_xsubs.h"
+
+static GPerlXSubIndex *
+SvGPerlXSubIndex (SV * sv)
+{
+	if (!SvROK (sv) || !sv_derived_from (sv, "XSubs::Index"))
+		croak ("%s is not an XSubs::Index", SvPV_nolen (sv));
+	return INT2PTR (GPerlXSubIndex *, SvIV (SvRV (sv)));
+}
+
+MODULE = XSubs::Index	PACKAGE = XSubs::Index	PREFIX = perl_xsub_index_
+
+=for object XSubs::Index Constant-time XSUB and prototype queries
+
+=cut
+
+=for apidoc
+
+Compiles the deparsed XSUB listing in I<source> (normally
+_Deparsed_XSubs.pm) into an index file at I<output>.  Croaks on failure.
+
+=cut
+void
+compile (class, source, output)
+	GPerlFilename source
+	GPerlFilename output
+    PREINIT:
+	GError * error = NULL;
+    CODE:
+	if (!perl_xsub_index_compile (source, output, &error))
+		perl_croak_mirror (NULL, error);
+
+=for apidoc
+
+Maps the index file I<filename>.
+
+=cut
+SV *
+new (class, filename)
+	GPerlFilename filename
+    PREINIT:
+	GError * error = NULL;
+	GPerlXSubIndex * index;
+    CODE:
+	index = perl_xsub_index_open (filename, &error);
+	if (!index)
+		perl_croak_mirror (NULL, error);
+	RETVAL = sv_setref_pv (newSV (0), "XSubs::Index", index);
+    OUTPUT:
+	RETVAL
+
+void
+DESTROY (sv)
+	SV * sv
+    CODE:
+	perl_xsub_index_close (SvGPerlXSubIndex (sv));
+
+=for apidoc
+
+Whether I<name>, a fully qualified "Package::sub", is a known XSUB.
+
+=cut
+gboolean
+exists (sv, name)
+	SV * sv
+	const char * name
+    CODE:
+	RETVAL = perl_xsub_index_lookup_name (SvGPerlXSubIndex (sv), name, NULL);
+    OUTPUT:
+	RETVAL
+
+=for apidoc
+
+=for signature (exists, prototype) = $index->lookup ($name)
+
+In list context, whether I<name> is a known XSUB followed by its prototype
+(undef if it has none).  In scalar context, just the prototype.
+
+=cut
+void
+lookup (sv, name)
+	SV * sv
+	const char * name
+    PREINIT:
+	const char * prototype = NULL;
+	gboolean found;
+    PPCODE:
+	found = perl_xsub_index_lookup_name (SvGPerlXSubIndex (sv), name,
+	                                      &prototype);
+	if (GIMME_V == G_ARRAY)
+		XPUSHs (found ? &PL_sv_yes : &PL_sv_no);
+	XPUSHs (prototype ? sv_2mortal (newSVpv (prototype, 0)) : &PL_sv_undef);
+
+guint
+perl_xsub_index_get_n_subs (sv)
+	SV * sv
+    C_ARGS:
+	SvGPerlXSubIndex (sv)
+
+=for apidoc
+
+Returns the names of all packages in the index, sorted.
+
+=cut
+void
+packages (sv)
+	SV * sv
+    PREINIT:
+	GPerlXSubIndex * index;
+	guint i, n;
+    PPCODE:
+	index = SvGPerlXSubIndex (sv);
+	n = perl_xsub_index_get_n_packages (index);
+	EXTEND (SP, n);
+	for (i = 0 ; i < n ; i++)
+		PUSHs (sv_2mortal (newSVpv (perl_xsub_index_get_package (index, i), 0)));
@@ -0,0 +1,116 @@
+#ifndef __PERL_ABERRATION_H__
+#define __PERL_ABERRATION_H__
+
+#include <glib.h>
+
+/*
+ * table-driven relativistic aberration and Doppler factor, as described in
+ * effect.pl.  a source moving with speed beta (c = 1) emits at polar angle
+ * theta0 in its rest frame; we want the observed angle
+ *
+ *   tan (theta / 2) = sqrt ((1 - beta) / (1 + beta)) tan (theta0 / 2)
+ *
+ * and the Doppler factor f_observed / f_emitted = gamma (1 + beta cos theta0).
+ *
+ * the table is sampled uniformly in rapidity and in theta0, where both
+ * functions are smooth all the way to beta_max, and read back with
+ * bilinear interpolation.  it is not indexed by (beta, cos theta0): the
+ * curvature in beta grows like 1 / (1 - beta)^2, so at beta_max = 0.99 a
+ * table of the same size sampled uniformly in beta is about 25 times less
+ * accurate, and theta has an infinite slope in cos theta0 at both poles.
+ * the price is a log1p to find the row, paid once per call for a single
+ * speed and once per run of equal speeds in the array lookup.
+ *
+ * when a table is built, every cell is checked at its centre against the
+ * exact formulas and the worst errors are kept, so callers can see what
+ * accuracy they are getting.  speeds beyond the table's range are
+ * evaluated exactly.
+ */
+
+typedef struct _GPerlAberrationTable GPerlAberrationTable;
+
+/*
+=item GPerlAberrationTable * perl_aberration_table_new (gdouble beta_max, guint n_rapidity, guint n_angle)
+
+Build a table covering speeds up to I<beta_max> with I<n_rapidity> by
+I<n_angle> cells.  Returns NULL if I<beta_max> is not in (0, 1) or either
+size is zero.
+
+=item const GPerlAberrationTable * perl_aberration_table_default (void)
+
+A shared table up to beta = 0.99 with 256 x 512 cells, built on first use.
+A dense sweep (see gperlaberrationbench.c) puts its interpolation errors
+below 3.5e-4 radians in angle and 5e-4 in relative Doppler factor.
+
+=cut
+*/
+GPerlAberrationTable       * perl_aberration_table_new     (gdouble beta_max,
+                                                             guint   n_rapidity,
+                                                             guint   n_angle);
+void                         perl_aberration_table_free    (GPerlAberrationTable * table);
+const GPerlAberrationTable * perl_aberration_table_default (void);
+
+/*
+=item void perl_aberration_table_get_error (const GPerlAberrationTable * table, gdouble * angle_error, gdouble * doppler_error)
+
+The worst absolute angle error (radians) and relative Doppler factor error
+seen at the cell centres when the table was built.  This is an estimate;
+the true maximum can be slightly larger.
+
+=cut
+*/
+void perl_aberration_table_get_error (const GPerlAberrationTable * table,
+                                       gdouble                    * angle_error,
+                                       gdouble                    * doppler_error);
+
+/*
+=item void perl_aberration_exact (gdouble beta, gdouble theta0, gdouble * theta, gdouble * doppler)
+
+=item void perl_aberration_lookup (const GPerlAberrationTable * table, gdouble beta, gdouble theta0, gdouble * theta, gdouble * doppler)
+
+Evaluate one sample, exactly or from I<table>.  I<beta> may be negative
+(source receding along x); I<theta0> is a polar angle in [0, pi].  Either
+output pointer may be NULL.  The lookups produce NaN when I<beta> is NaN
+or not below 1 in magnitude, or I<theta0> is NaN.
+
+=cut
+*/
+void perl_aberration_exact  (gdouble                      beta,
+                              gdouble                      theta0,
+                              gdouble                    * theta,
+                              gdouble                    * doppler);
+void perl_aberration_lookup (const GPerlAberrationTable * table,
+                              gdouble                      beta,
+                              gdouble                      theta0,
+                              gdouble                    * theta,
+                              gdouble                    * doppler);
+
+/*
+=item void perl_aberration_lookup_angles (const GPerlAberrationTable * table, gdouble beta, const gdouble * theta0, gdouble * theta, gdouble * doppler, gsize n)
+
+Batch lookup of I<n> angles at one speed, the starfield case: the speed
+row is resolved once for the whole batch.
+
+=item void perl_aberration_lookup_array (const GPerlAberrationTable * table, const gdouble * beta, const gdouble * theta0, gdouble * theta, gdouble * doppler, gsize n)
+
+Batch lookup with a speed per sample, the spectrum case.  Consecutive
+samples at the same speed share the row lookup.
+
+Either output array may be NULL in both.
+
+=cut
+*/
+void perl_aberration_lookup_angles (const GPerlAberrationTable * table,
+                                     gdouble                      beta,
+                                     const gdouble              * theta0,
+                                     gdouble                    * theta,
+                                     gdouble                    * doppler,
+                                     gsize                        n);
+void perl_aberration_lookup_array  (const GPerlAberrationTable * table,
+                                     const gdouble              * beta,
+                                     const gdouble              * theta0,
+                                     gdouble                    * theta,
+                                     gdouble                    * doppler,
+                                     gsize                        n);
+
+#endif /* __PERL_ABERRATION_H__ */
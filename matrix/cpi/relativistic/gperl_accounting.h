@@ -0,0 +1,96 @@
+#ifndef __PERL_ACCOUNTING_H__
+#define __PERL_ACCOUNTING_H__
+
+#include "gperl.h"
+
+/*
+ * live accounting of perl wrappers, per GType.
+ *
+ * PERL_OBJECT_VITALS and PERL_WRAPPER_VITALS describe one wrapper at a
+ * time, which is no help when a long-running process grows and nobody
+ * knows which type is to blame.  wrapper code reports every wrapper it
+ * creates and destroys, and every toggle reference flip, to the hooks
+ * below; while accounting is enabled they keep per-type counts of live
+ * wrappers, their bytes and how many are pinned by C references.  one
+ * wrapper in every sample_every also records the perl file and line that
+ * created it, and stays attributed to that call site until it dies, so a
+ * growing site count points at the code holding on to wrappers.
+ *
+ * counting starts when accounting is enabled; wrappers that were already
+ * alive show up as negative live counts when they die, so compare
+ * snapshots taken after enabling rather than reading one in isolation.
+ * with accounting disabled, each hook costs one atomic read.
+ */
+
+typedef struct {
+	GType        type;
+	gint64       n_live;
+	gint64       bytes;		/* live bytes, as reported by the hooks */
+	guint64      n_created;
+	guint64      n_destroyed;
+	gint64       n_pinned;		/* kept alive by references from C */
+	GHashTable * sites;		/* "file:line" -> live sampled wrappers */
+} GPerlWrapperStats;
+
+/*
+=item void perl_wrapper_accounting_enable (guint sample_every)
+
+Start counting, or change the sampling rate if counting already.  One
+wrapper in I<sample_every> has its creation site recorded; 0 records no
+sites.
+
+=item void perl_wrapper_accounting_disable (void)
+
+Stop counting and forget everything recorded so far.
+
+=item gboolean perl_wrapper_accounting_is_enabled (void)
+
+=cut
+*/
+void     perl_wrapper_accounting_enable (guint sample_every);
+void     perl_wrapper_accounting_disable (void);
+gboolean perl_wrapper_accounting_is_enabled (void);
+
+/*
+=item void perl_wrapper_accounting_created (GType type, gconstpointer wrapper, gsize bytes)
+
+=item void perl_wrapper_accounting_destroyed (GType type, gconstpointer wrapper, gsize bytes)
+
+Report that I<wrapper>, a wrapper for an instance of I<type>, was created
+or destroyed.  I<wrapper> only identifies the wrapper for call site
+attribution and must stay unique while it lives.  I<bytes> is what the
+wrapper accounts for; 0 means the instance size of I<type>, for
+instantiatable types.  Must be called from a perl thread.
+
+=item void perl_wrapper_accounting_toggled (GType type, gboolean is_last_ref)
+
+Report a toggle reference notification for an instance of I<type>: with
+I<is_last_ref> false the perl wrapper is pinned by references held
+elsewhere, with it true it no longer is.
+
+=cut
+*/
+void perl_wrapper_accounting_created   (GType         type,
+                                        gconstpointer wrapper,
+                                        gsize         bytes);
+void perl_wrapper_accounting_destroyed (GType         type,
+                                        gconstpointer wrapper,
+                                        gsize         bytes);
+void perl_wrapper_accounting_toggled   (GType         type,
+                                        gboolean      is_last_ref);
+
+/*
+=item GPerlWrapperStats * perl_wrapper_accounting_snapshot (guint * n_types)
+
+A copy of the counters of every type seen since accounting was enabled.
+Free it with C<perl_wrapper_accounting_snapshot_free>.
+
+=item void perl_wrapper_accounting_snapshot_free (GPerlWrapperStats * stats, guint n_types)
+
+=cut
+*/
+GPerlWrapperStats * perl_wrapper_accounting_snapshot (guint * n_types);
+void perl_wrapper_accounting_snapshot_free (GPerlWrapperStats * stats,
+                                            guint               n_types);
+
+#endif /* __PERL_ACCOUNTING_H__ */
@@ -0,0 +1,58 @@
+#ifndef __PERL_ARGV_H__
+#define __PERL_ARGV_H__
+
+#include "gperl.h"
+
+/*
+ * GPerlArgv bridges @ARGV to the argc/argv pair that GOption and friends
+ * want, without copying the arguments.
+ *
+ * perl_argv_new points argv straight at the string buffers of $0 and the
+ * elements of @ARGV, holding a reference on each scalar so the buffers
+ * stay put; the whole bridge is a single allocation however long the
+ * list is.  option parsing only removes entries and reorders pointers, so
+ * perl_argv_update puts the surviving original scalars back into @ARGV as
+ * they are, leaves @ARGV alone entirely if nothing changed, and creates a
+ * new scalar only for an entry the C side replaced with a string of its
+ * own.
+ *
+ * the strings are borrowed: C code must not write into them, and perl
+ * code must not modify @ARGV or $0 while the bridge is alive.  that
+ * includes option callbacks written in perl, which run in the middle of
+ * parsing while argv still points at the raw buffers of those scalars.
+ */
+
+/*
+=item GPerlArgv * perl_argv_new (void)
+
+A bridge over $0 and @ARGV.  I<argv> is NULL-terminated, so it can be
+handed to functions that expect either form.  Undefined elements of
+@ARGV show up as empty strings.
+
+=item void perl_argv_update (GPerlArgv * pargv)
+
+Make @ARGV reflect I<argc> and I<argv> after the C side has parsed them.
+
+=item void perl_argv_free (GPerlArgv * pargv)
+
+Release the references and the bridge.  @ARGV is not touched.
+
+=cut
+*/
+
+#if GLIB_CHECK_VERSION (2, 6, 0)
+
+/*
+=item gboolean perl_option_context_parse (GOptionContext * context, GError ** error)
+
+Run C<g_option_context_parse> over @ARGV through a GPerlArgv, and update
+@ARGV to what is left if parsing succeeds.
+
+=cut
+*/
+gboolean perl_option_context_parse (GOptionContext  * context,
+                                    GError         ** error);
+
+#endif /* 2.6.0 */
+
+#endif /* __PERL_ARGV_H__ */
@@ -0,0 +1,98 @@
+#ifndef __PERL_BOXED_POOL_H__
+#define __PERL_BOXED_POOL_H__
+
+#include "gperl.h"
+
+/*
+ * pooled, copy-on-write boxed wrappers.
+ *
+ * small boxed types such as rectangles, colors and iterators are wrapped
+ * far more often than they are kept.  register them with the wrapper class
+ * below and the per-wrapper bookkeeping comes from a per-type free list
+ * instead of the allocator.  inside a borrow scope, perl_new_boxed_cow
+ * hands perl the caller's own boxed without copying it; the copy is only
+ * made if the wrapper is still alive when the scope ends, or when perl
+ * asks to modify it.
+ */
+
+/*
+=item GPerlBoxedWrapperClass * perl_pooled_boxed_wrapper_class (void)
+
+A wrapper class for C<perl_register_boxed> that keeps freed wrappers on a
+per-type free list and counts allocations per type.
+
+=cut
+*/
+GPerlBoxedWrapperClass * perl_pooled_boxed_wrapper_class (void);
+
+/*
+=item void perl_register_pooled_boxed (GType type, const char * package)
+
+C<perl_register_boxed> with the pooled wrapper class, recording that
+I<type> uses it so C<perl_new_boxed_cow> may borrow for it straight away.
+
+=cut
+*/
+void perl_register_pooled_boxed (GType type, const char * package);
+
+/*
+=item void perl_boxed_borrow_begin (void)
+
+=item void perl_boxed_borrow_end (void)
+
+Bracket a region, typically a signal emission or a getter, during which
+boxed values passed to C<perl_new_boxed_cow> are guaranteed to stay valid
+and unchanged.  When the scope ends, every borrowed wrapper that perl still
+holds gets its own copy.  Scopes nest, and belong to the calling thread:
+a scope open on one thread lets nothing borrow on another.
+
+=item SV * perl_new_boxed_cow (gpointer boxed, GType type)
+
+Like C<perl_new_boxed_copy>, but inside a borrow scope on this thread the
+copy is deferred.  Borrowing needs I<type> to use the pooled wrapper
+class, as known from C<perl_register_pooled_boxed> or from an earlier
+wrap; for any other type this simply is C<perl_new_boxed_copy>.
+
+=item gpointer perl_boxed_make_writable (SV * sv, GType type)
+
+Unwrap I<sv> for modification, copying a borrowed boxed first so the
+change never reaches the lender.  Setters should use this instead of
+C<perl_get_boxed_check>.  Croaks if I<type> is not known to use the
+pooled wrapper class.
+
+=cut
+*/
+void     perl_boxed_borrow_begin  (void);
+void     perl_boxed_borrow_end    (void);
+SV *     perl_new_boxed_cow       (gpointer boxed, GType type);
+gpointer perl_boxed_make_writable (SV * sv, GType type);
+
+/*
+=item GPerlBoxedPoolStats
+
+ n_wraps     wrappers created
+ n_reused    ... of which came from the free list
+ n_copies    boxed values copied, eagerly or on write
+ n_borrowed  wrappers created without a copy
+ n_deferred  ... of which had to be copied when the scope ended
+ n_live      wrappers currently alive
+ n_free      wrappers on the free list
+
+=cut
+*/
+typedef struct {
+	guint64 n_wraps;
+	guint64 n_reused;
+	guint64 n_copies;
+	guint64 n_borrowed;
+	guint64 n_deferred;
+	guint   n_live;
+	guint   n_free;
+} GPerlBoxedPoolStats;
+
+/* fills in stats for every pooled type seen so far; returns the number of
+ * types.  types and stats are newly allocated, free them with g_free. */
+guint perl_boxed_pool_get_stats (GType               ** types,
+                                  GPerlBoxedPoolStats ** stats);
+
+#endif /* __PERL_BOXED_POOL_H__ */
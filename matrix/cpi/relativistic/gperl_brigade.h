@@ -0,0 +1,189 @@
+#ifndef __PERL_BRIGADE_H__
+#define __PERL_BRIGADE_H__
+
+#include <glib.h>
+
+/*
+ * zero-copy filter pipeline, for the streaming filters described in
+ * filter.pl.
+ *
+ * data moves through the pipeline as brigades: ordered lists of buckets,
+ * where each bucket is a reference-counted GBytes.  splitting a brigade,
+ * moving buckets from one brigade to another or taking a slice of a bucket
+ * only touches reference counts, so a stage that passes most of its input
+ * through unchanged never copies it.  file buckets map the file instead of
+ * reading it.
+ *
+ * a pipeline is a chain of stages, each described by a GPerlFilterClass of
+ * init/process/finalize hooks in the same spirit as
+ * GPerlBoxedWrapperClass.  stages run either in the pushing thread or each
+ * on a thread of its own, connected by bounded queues; in the threaded
+ * case a full queue blocks whoever is feeding it, so a slow stage throttles
+ * the producer instead of letting buffers pile up.
+ */
+
+/*
+ * --- brigades ---------------------------------------------------------------
+ */
+typedef struct _GPerlBrigade GPerlBrigade;
+
+typedef struct {
+	gconstpointer data;
+	gsize         size;
+} GPerlBucketVector;
+
+GPerlBrigade * perl_brigade_new  (void);
+void           perl_brigade_free (GPerlBrigade * brigade);
+
+/* takes a new reference on bytes */
+void     perl_brigade_append_bytes  (GPerlBrigade * brigade, GBytes * bytes);
+/* copies; for small data that is not already owned by anyone */
+void     perl_brigade_append_data   (GPerlBrigade * brigade, gconstpointer data, gsize size);
+void     perl_brigade_append_static (GPerlBrigade * brigade, gconstpointer data, gsize size);
+gboolean perl_brigade_append_file   (GPerlBrigade * brigade, const char * filename, GError ** error);
+
+gsize    perl_brigade_get_length (const GPerlBrigade * brigade);
+guint    perl_brigade_get_n_buckets (const GPerlBrigade * brigade);
+gboolean perl_brigade_is_empty   (const GPerlBrigade * brigade);
+
+/*
+=item gboolean perl_brigade_get_eos (const GPerlBrigade * brigade)
+
+=item void perl_brigade_set_eos (GPerlBrigade * brigade, gboolean eos)
+
+End-of-stream marker.  The pipeline sets it on the last brigade it hands
+to the sink, even if that brigade is empty, so the sink always learns that
+the stream is over.  This holds when a stage has failed too; the sink
+then gets an empty end-of-stream brigade in place of the rest of the
+data.
+
+=cut
+*/
+gboolean perl_brigade_get_eos (const GPerlBrigade * brigade);
+void     perl_brigade_set_eos (GPerlBrigade * brigade, gboolean eos);
+
+/*
+=item GBytes * perl_brigade_pop (GPerlBrigade * brigade)
+
+Remove the first bucket and hand its reference to the caller; NULL if the
+brigade is empty.
+
+=item void perl_brigade_move (GPerlBrigade * dest, GPerlBrigade * src)
+
+Append all of I<src>'s buckets to I<dest>, leaving I<src> empty.
+
+=item GPerlBrigade * perl_brigade_split (GPerlBrigade * brigade, gsize offset)
+
+Cut I<brigade> at byte I<offset> and return everything after it as a new
+brigade.  A bucket straddling the cut is shared between the two halves
+rather than copied.
+
+=cut
+*/
+GBytes *       perl_brigade_pop   (GPerlBrigade * brigade);
+void           perl_brigade_move  (GPerlBrigade * dest, GPerlBrigade * src);
+GPerlBrigade * perl_brigade_split (GPerlBrigade * brigade, gsize offset);
+
+/*
+=item guint perl_brigade_get_vectors (const GPerlBrigade * brigade, GPerlBucketVector * vectors, guint n_vectors)
+
+Fill in up to I<n_vectors> scatter-gather entries for the brigade's
+buckets, suitable for writev and friends, and return how many were used.
+
+=item GBytes * perl_brigade_flatten (const GPerlBrigade * brigade)
+
+The brigade's contents as one contiguous buffer.  This is the only call
+that copies, and a single-bucket brigade is returned without copying.
+
+=cut
+*/
+guint    perl_brigade_get_vectors (const GPerlBrigade * brigade,
+                                    GPerlBucketVector  * vectors,
+                                    guint                n_vectors);
+GBytes * perl_brigade_flatten     (const GPerlBrigade * brigade);
+
+/*
+ * --- stages -----------------------------------------------------------------
+ */
+typedef struct _GPerlFilterClass GPerlFilterClass;
+
+/*
+=item GPerlFilterClass
+
+ init      called once before the first data; may be NULL
+ process   consume (some of) I<in> and append results to I<out>.  whatever
+           is left in I<in> is handed back on the next call, ahead of new
+           data, so a stage that needs more context can simply wait.
+ finalize  called once after the last data, with anything still left over
+           in I<in>; may be NULL, in which case leftovers are passed on
+
+Every hook gets the I<user_data> given to C<perl_filter_pipeline_add>.  A
+hook reports failure by returning FALSE and setting I<error>; the
+pipeline then stops and reports that error.
+
+=cut
+*/
+struct _GPerlFilterClass {
+	const char * name;
+	gboolean (*init)     (gpointer       user_data,
+	                      GError      ** error);
+	gboolean (*process)  (gpointer       user_data,
+	                      GPerlBrigade * in,
+	                      GPerlBrigade * out,
+	                      GError      ** error);
+	gboolean (*finalize) (gpointer       user_data,
+	                      GPerlBrigade * in,
+	                      GPerlBrigade * out,
+	                      GError      ** error);
+};
+
+/*
+ * --- pipelines --------------------------------------------------------------
+ */
+typedef struct _GPerlFilterPipeline GPerlFilterPipeline;
+
+/* receives every brigade leaving the last stage; takes ownership of it. */
+typedef void (*GPerlFilterSinkFunc) (GPerlBrigade * brigade,
+                                     gpointer       user_data);
+
+/*
+=item GPerlFilterPipeline * perl_filter_pipeline_new (GPerlFilterSinkFunc sink, gpointer sink_data, guint queue_depth)
+
+Create an empty pipeline whose output goes to I<sink>.  If I<queue_depth>
+is zero the stages run synchronously inside C<perl_filter_pipeline_push>;
+otherwise every stage gets its own thread, stages are connected by queues
+holding at most I<queue_depth> brigades, and I<sink> is called from the
+last stage's thread.
+
+=item void perl_filter_pipeline_add (GPerlFilterPipeline * pipeline, const GPerlFilterClass * klass, gpointer user_data, GDestroyNotify destroy)
+
+Append a stage.  Stages can only be added before the first push.
+
+=item gboolean perl_filter_pipeline_push (GPerlFilterPipeline * pipeline, GPerlBrigade * brigade, GError ** error)
+
+Feed I<brigade>, which the pipeline takes over, into the first stage.  In
+threaded mode this blocks while the first queue is full.  Returns FALSE
+once any stage has failed.
+
+=item gboolean perl_filter_pipeline_finish (GPerlFilterPipeline * pipeline, GError ** error)
+
+Signal the end of the input, run every finalize hook, wait for the last
+brigade to reach the sink and report the first error any stage raised.
+
+=cut
+*/
+GPerlFilterPipeline * perl_filter_pipeline_new    (GPerlFilterSinkFunc       sink,
+                                                    gpointer                  sink_data,
+                                                    guint                     queue_depth);
+void                  perl_filter_pipeline_add    (GPerlFilterPipeline     * pipeline,
+                                                    const GPerlFilterClass  * klass,
+                                                    gpointer                  user_data,
+                                                    GDestroyNotify            destroy);
+gboolean              perl_filter_pipeline_push   (GPerlFilterPipeline     * pipeline,
+                                                    GPerlBrigade            * brigade,
+                                                    GError                 ** error);
+gboolean              perl_filter_pipeline_finish (GPerlFilterPipeline     * pipeline,
+                                                    GError                 ** error);
+void                  perl_filter_pipeline_free   (GPerlFilterPipeline     * pipeline);
+
+#endif /* __PERL_BRIGADE_H__ */
@@ -0,0 +1,132 @@
+#ifndef __PERL_INT64_H__
+#define __PERL_INT64_H__
+
+#include "gperl.h"
+
+/*
+ * array-level 64 bit integer conversions.
+ *
+ * SvGInt64 and friends handle one scalar at a time, and on perls with
+ * 32 bit IVs every one of them goes through a string.  these convert
+ * whole columns: perl arrays to and from gint64/guint64 buffers, packed
+ * wire-format strings to and from buffers (with the byte swapping done
+ * in vector registers where the cpu allows), and buffers to and from
+ * GValue arrays and "ax"/"at" GVariants.
+ *
+ * on 32 bit IV builds the conversion back to perl first range-checks the
+ * whole buffer, and only falls back to the string path for elements that
+ * do not fit in an IV.
+ */
+
+/*
+=item void perl_int64_array_from_av (AV * av, gint64 * values, gsize n_values)
+
+=item void perl_uint64_array_from_av (AV * av, guint64 * values, gsize n_values)
+
+Convert the first I<n_values> elements of I<av>; missing elements become
+zero.  The unsigned variant croaks on negative elements.
+
+=item AV * perl_int64_array_to_av (const gint64 * values, gsize n_values)
+
+=item AV * perl_uint64_array_to_av (const guint64 * values, gsize n_values)
+
+A new array holding I<values>.
+
+=cut
+*/
+void perl_int64_array_from_av  (AV * av, gint64 * values, gsize n_values);
+void perl_uint64_array_from_av (AV * av, guint64 * values, gsize n_values);
+AV * perl_int64_array_to_av    (const gint64 * values, gsize n_values);
+AV * perl_uint64_array_to_av   (const guint64 * values, gsize n_values);
+
+/*
+=item void perl_int64_array_swap (guint64 * values, gsize n_values)
+
+Byte-swap every element in place.
+
+=item void perl_int64_array_unpack (const guchar * data, gsize n_values, gboolean big_endian, guint64 * values)
+
+=item void perl_int64_array_pack (const guint64 * values, gsize n_values, gboolean big_endian, guchar * data)
+
+Convert between host order and a packed wire format of I<n_values> 8 byte
+words in the given byte order.  I<data> needs no particular alignment.
+Signed values can be passed by casting, the bits are the same.
+
+=cut
+*/
+void perl_int64_array_swap   (guint64 * values, gsize n_values);
+void perl_int64_array_unpack (const guchar  * data,
+                               gsize           n_values,
+                               gboolean        big_endian,
+                               guint64       * values);
+void perl_int64_array_pack   (const guint64 * values,
+                               gsize           n_values,
+                               gboolean        big_endian,
+                               guchar        * data);
+
+/*
+=item gsize perl_int64_array_check_range (const gint64 * values, gsize n_values, gint64 min, gint64 max)
+
+=item gsize perl_uint64_array_check_range (const guint64 * values, gsize n_values, guint64 max)
+
+The index of the first element outside [I<min>, I<max>], or I<n_values>
+if they all fit.
+
+=cut
+*/
+gsize perl_int64_array_check_range  (const gint64  * values,
+                                      gsize           n_values,
+                                      gint64          min,
+                                      gint64          max);
+gsize perl_uint64_array_check_range (const guint64 * values,
+                                      gsize           n_values,
+                                      guint64         max);
+
+/*
+=item void perl_int64_array_to_values (const gint64 * values, gsize n_values, gboolean is_unsigned, GValue * gvalues)
+
+Initialize the zero-filled I<gvalues> as G_TYPE_INT64 or G_TYPE_UINT64
+and store I<values> into them.
+
+=item gboolean perl_int64_array_from_values (const GValue * gvalues, gsize n_values, gint64 * values)
+
+Read back GValues holding any 64 bit integer type; FALSE if one holds
+something else.
+
+=cut
+*/
+void     perl_int64_array_to_values   (const gint64  * values,
+                                        gsize           n_values,
+                                        gboolean        is_unsigned,
+                                        GValue        * gvalues);
+gboolean perl_int64_array_from_values (const GValue  * gvalues,
+                                        gsize           n_values,
+                                        gint64        * values);
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+/*
+=item GVariant * perl_int64_array_to_variant (const gint64 * values, gsize n_values, gboolean is_unsigned)
+
+A new floating "ax" or "at" variant holding a copy of I<values>.
+
+=cut
+*/
+GVariant *     perl_int64_array_to_variant   (const gint64 * values,
+                                               gsize          n_values,
+                                               gboolean       is_unsigned);
+#endif /* 2.32.0 */
+
+#if GLIB_CHECK_VERSION (2, 24, 0)
+/*
+=item const gint64 * perl_int64_array_from_variant (GVariant * variant, gsize * n_values)
+
+The elements of an "ax" or "at" variant, without copying; NULL for any
+other type.  The buffer belongs to I<variant>.
+
+=cut
+*/
+const gint64 * perl_int64_array_from_variant (GVariant     * variant,
+                                               gsize        * n_values);
+#endif /* 2.24.0 */
+
+#endif /* __PERL_INT64_H__ */
@@ -0,0 +1,116 @@
+#ifndef __PERL_LORENTZ_H__
+#define __PERL_LORENTZ_H__
+
+#include <glib.h>
+
+/*
+ * batched special-relativity kernels.  everything here works in units where
+ * c = 1, on plain arrays of doubles, so the same code serves the Perl
+ * bindings in Lorentz.xs and any C caller that already has its particles in
+ * memory.
+ *
+ * each kernel has a scalar, an AVX2 and an AVX-512 implementation; the one
+ * to use is picked once at runtime from the cpu features.  all of them
+ * evaluate exactly the same sequence of IEEE adds, multiplies, divides and
+ * square roots (never fused), so the results are bit-for-bit identical
+ * whichever path ran.
+ */
+
+/*
+=item GPerlFourVectors
+
+A batch of 4-vectors in structure-of-arrays layout: I<t>, I<x>, I<y> and I<z>
+each point to I<n> doubles.  The arrays need not be aligned.
+
+=cut
+*/
+typedef struct _GPerlFourVectors GPerlFourVectors;
+struct _GPerlFourVectors {
+	gdouble * t;
+	gdouble * x;
+	gdouble * y;
+	gdouble * z;
+	gsize     n;
+};
+
+typedef enum {
+	PERL_LORENTZ_ISA_SCALAR,
+	PERL_LORENTZ_ISA_AVX2,
+	PERL_LORENTZ_ISA_AVX512
+} GPerlLorentzIsa;
+
+/*
+=item GPerlLorentzIsa perl_lorentz_get_isa (void)
+
+=item void perl_lorentz_set_isa (GPerlLorentzIsa isa)
+
+Query or force the instruction set used by the kernels.  Forcing a path the
+cpu does not support falls back to the best one it does; this is meant for
+cross-checking the paths against each other, not for tuning.
+
+=cut
+*/
+GPerlLorentzIsa perl_lorentz_get_isa (void);
+void perl_lorentz_set_isa (GPerlLorentzIsa isa);
+
+/*
+=item void perl_lorentz_boost (GPerlFourVectors * vectors, gdouble bx, gdouble by, gdouble bz)
+
+Transform I<vectors> in place into the frame moving with velocity
+(I<bx>, I<by>, I<bz>) relative to the current one:
+
+ t' = gamma (t - beta.r)
+ r' = r + ((gamma - 1) / beta^2 (beta.r) - gamma t) beta
+
+The speed must be below 1.
+
+=cut
+*/
+void perl_lorentz_boost (GPerlFourVectors * vectors,
+                          gdouble            bx,
+                          gdouble            by,
+                          gdouble            bz);
+
+/*
+=item void perl_lorentz_velocity_add (const gdouble * u, const gdouble * v, gdouble * w, gsize n)
+
+Collinear velocity addition, w[i] = (u[i] + v[i]) / (1 + u[i] v[i]).  I<w>
+may alias either input.
+
+=item void perl_lorentz_velocity_add_3 (gdouble * ux, gdouble * uy, gdouble * uz, gsize n, gdouble vx, gdouble vy, gdouble vz)
+
+Replace the particle velocities I<u>, measured in a frame moving with
+velocity I<v>, by the velocities seen in the rest frame:
+
+ u = (u'/gamma + v (1 + gamma/(gamma + 1) v.u')) / (1 + v.u')
+
+=cut
+*/
+void perl_lorentz_velocity_add   (const gdouble * u,
+                                   const gdouble * v,
+                                   gdouble       * w,
+                                   gsize           n);
+void perl_lorentz_velocity_add_3 (gdouble * ux,
+                                   gdouble * uy,
+                                   gdouble * uz,
+                                   gsize     n,
+                                   gdouble   vx,
+                                   gdouble   vy,
+                                   gdouble   vz);
+
+/*
+=item void perl_lorentz_gamma (const gdouble * beta, gdouble * gamma, gsize n)
+
+=item void perl_lorentz_rapidity (const gdouble * beta, gdouble * rapidity, gsize n)
+
+Lorentz factor 1/sqrt(1 - beta^2) and rapidity atanh(beta) of each speed.
+The rapidity needs a logarithm, which has no correctly rounded vector
+form, so the vector paths only prepare its argument and the logarithm
+itself is always taken by libm.
+
+=cut
+*/
+void perl_lorentz_gamma    (const gdouble * beta, gdouble * gamma, gsize n);
+void perl_lorentz_rapidity (const gdouble * beta, gdouble * rapidity, gsize n);
+
+#endif /* __PERL_LORENTZ_H__ */
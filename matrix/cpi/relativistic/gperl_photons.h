@@ -0,0 +1,72 @@
+#ifndef __PERL_PHOTONS_H__
+#define __PERL_PHOTONS_H__
+
+#include <glib.h>
+
+/*
+ * Monte Carlo sweep over the reception-time experiment in photons.pl: a
+ * source moving with speed beta along x emits two light signals a proper
+ * time dT0 apart, into a direction drawn isotropically in its rest frame.
+ * an observer at distance R (along the aberrated direction) receives them
+ * at T1 = R and T2 = gamma dT0 + r2, and we histogram dT = T2 - T1 in
+ * units of dT0 (c = 1, dT0 = 1).
+ *
+ * events are cut into fixed-size tasks that worker threads pull from
+ * work-stealing queues.  every event draws its random numbers from a
+ * counter-based generator keyed by the seed and indexed by the event
+ * number, so a sweep gives the same histogram and mean for any number of
+ * threads.
+ */
+
+typedef struct _GPerlPhotonSweep GPerlPhotonSweep;
+struct _GPerlPhotonSweep {
+	gdouble  beta;		/* source speed, 0 <= beta < 1 */
+	gdouble  distance;	/* R, in light-dT0 */
+	guint64  n_events;
+	guint64  seed;
+	guint    n_threads;	/* 0 means one per processor */
+	guint64  events_per_task;	/* 0 picks a default */
+	/* histogram range and resolution for dT/dT0 */
+	gdouble  hist_min;
+	gdouble  hist_max;
+	guint    n_bins;
+};
+
+typedef struct _GPerlPhotonHistogram GPerlPhotonHistogram;
+struct _GPerlPhotonHistogram {
+	gdouble   min;
+	gdouble   max;
+	guint     n_bins;
+	guint64 * bins;
+	guint64   underflow;
+	guint64   overflow;
+	guint64   n_events;
+	gdouble   mean;
+};
+
+/*
+=item gboolean perl_photon_sweep_run (const GPerlPhotonSweep * sweep, GPerlPhotonHistogram * histogram)
+
+Run I<sweep> to completion and fill in I<histogram>, whose I<bins> are
+allocated here and must be released with
+C<perl_photon_histogram_clear>.  Returns FALSE, leaving I<histogram>
+empty, if the sweep parameters make no sense.
+
+=cut
+*/
+gboolean perl_photon_sweep_run       (const GPerlPhotonSweep * sweep,
+                                       GPerlPhotonHistogram   * histogram);
+void     perl_photon_histogram_clear (GPerlPhotonHistogram   * histogram);
+
+/*
+=item gdouble perl_photon_delay (gdouble beta, gdouble distance, gdouble cos_theta0)
+
+The single-event formula: reception-time difference in units of dT0 for an
+emission at I<cos_theta0> in the source frame.  Tends to
+gamma (1 - beta cos theta) as the distance grows.
+
+=cut
+*/
+gdouble perl_photon_delay (gdouble beta, gdouble distance, gdouble cos_theta0);
+
+#endif /* __PERL_PHOTONS_H__ */
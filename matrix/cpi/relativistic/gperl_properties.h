@@ -0,0 +1,54 @@
+#ifndef __PERL_PROPERTIES_H__
+#define __PERL_PROPERTIES_H__
+
+#include "gperl.h"
+
+/*
+ * batched GObject property access.
+ *
+ * property names are resolved to GParamSpecs once per class and kept in a
+ * per-class cache, so code that sets the same handful of properties on
+ * thousands of objects pays for the class lookup (and the name
+ * canonicalization) only the first time.  the set side wraps the whole
+ * batch in a single freeze/thaw of notify.
+ */
+
+/*
+=item GParamSpec * perl_object_find_property (GType type, const char * name)
+
+Look up property I<name> on object type I<type> through the per-class
+cache.  Returns NULL if the class has no such property.  The returned
+pspec is owned by the cache, which holds a reference on it.
+
+=cut
+*/
+GParamSpec * perl_object_find_property (GType type, const char * name);
+
+/*
+=item void perl_object_get_properties (GObject * object, guint n_properties, GParamSpec ** pspecs, GValue * values)
+
+Fetch I<n_properties> properties into I<values>, which must be zero-filled;
+each one is initialized to its pspec's value type and must be unset by the
+caller.
+
+=item void perl_object_set_properties (GObject * object, guint n_properties, GParamSpec ** pspecs, const GValue * values)
+
+Set I<n_properties> properties under a single freeze/thaw of notify, so
+handlers see one notification per property after the whole batch has been
+applied.
+
+=cut
+*/
+void perl_object_get_properties (GObject     * object,
+                                  guint         n_properties,
+                                  GParamSpec ** pspecs,
+                                  GValue      * values);
+void perl_object_set_properties (GObject      * object,
+                                  guint          n_properties,
+                                  GParamSpec  ** pspecs,
+                                  const GValue * values);
+
+/* drop every cached class; for dynamic types that are about to go away. */
+void perl_object_property_cache_clear (void);
+
+#endif /* __PERL_PROPERTIES_H__ */
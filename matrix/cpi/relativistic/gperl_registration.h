@@ -0,0 +1,76 @@
+#ifndef __PERL_REGISTRATION_H__
+#define __PERL_REGISTRATION_H__
+
+#include "gperl.h"
+
+/*
+ * batched type registration.
+ *
+ * every push onto an @ISA invalidates the method resolution caches of the
+ * class and everything below it, so a boot section that registers
+ * thousands of types one at a time does a quadratic amount of cache work.
+ * inside a registration batch, perl_set_isa and perl_prepend_isa only
+ * record their edges; committing the batch runs the queued registrations,
+ * applies all edges class by class with @ISA magic held back, and then
+ * recomputes each touched class exactly once.
+ */
+
+typedef enum {
+	PERL_REGISTRATION_OBJECT,
+	PERL_REGISTRATION_BOXED,
+	PERL_REGISTRATION_FUNDAMENTAL,	/* enums and flags */
+	PERL_REGISTRATION_PARAM_SPEC
+} GPerlRegistrationKind;
+
+/*
+=item GPerlRegistrationStats
+
+Filled in by C<perl_registration_commit>.  Times are in microseconds.
+
+ n_registrations  queued registrations that were run
+ n_edges          ISA edges applied
+ n_classes        classes whose method resolution was recomputed
+ register_time    running the registrations
+ isa_time         storing the edges into the @ISA arrays
+ mro_time         recomputing method resolution
+
+If the environment variable GPERL_REGISTRATION_TIMING is set, every
+outermost commit also prints these to stderr.
+
+=cut
+*/
+typedef struct {
+	guint  n_registrations;
+	guint  n_edges;
+	guint  n_classes;
+	gint64 register_time;
+	gint64 isa_time;
+	gint64 mro_time;
+} GPerlRegistrationStats;
+
+/*
+=item void perl_registration_begin (void)
+
+Open a batch.  Batches nest; only the outermost commit does any work.
+
+=item void perl_registration_add (GPerlRegistrationKind kind, GType type, const char * package, gpointer wrapper_class)
+
+Queue a registration for the current batch, or run it right away if no
+batch is open.  I<wrapper_class> is the GPerlBoxedWrapperClass for boxed
+types and the GPerlValueWrapperClass for fundamentals, and may be NULL.
+
+=item void perl_registration_commit (GPerlRegistrationStats * stats)
+
+Close the batch opened by the matching C<perl_registration_begin>.
+I<stats> may be NULL.
+
+=cut
+*/
+void perl_registration_begin  (void);
+void perl_registration_add    (GPerlRegistrationKind    kind,
+                                GType                    type,
+                                const char             * package,
+                                gpointer                 wrapper_class);
+void perl_registration_commit (GPerlRegistrationStats * stats);
+
+#endif /* __PERL_REGISTRATION_H__ */
@@ -0,0 +1,105 @@
+#ifndef __PERL_SCHEDULER_H__
+#define __PERL_SCHEDULER_H__
+
+#include "gperl.h"
+
+#if GLIB_CHECK_VERSION (2, 28, 0)
+
+/*
+ * batched idle and timeout callbacks.
+ *
+ * every idle or timeout closure is a GSource of its own, so a busy
+ * application with many small handlers pays for a separate dispatch,
+ * interpreter entry and ENTER/SAVETMPS/FREETMPS/LEAVE per callback.  a
+ * scheduler keeps the perl callbacks itself instead, with one GSource per
+ * priority in use.  when that source dispatches it runs every callback of
+ * its priority that is due, inside one ENTER/SAVETMPS scope, until the
+ * queue is empty or the time budget is spent; whatever is left runs in
+ * the next batch, after GLib has had a chance to service everything of
+ * higher priority, such as redraws.  callbacks keep the usual contract:
+ * return true to stay scheduled, false to be removed.  the sources may
+ * recurse and callbacks wait on their queues until they run, so one that
+ * runs a nested main loop, such as a modal dialog, does not hold up the
+ * others of its priority.
+ *
+ * a scheduler must only be used from the thread that runs its context.
+ */
+
+typedef struct _GPerlScheduler GPerlScheduler;
+
+typedef struct {
+	guint64 n_batches;
+	guint64 n_callbacks;		/* callbacks run */
+	guint64 n_deferred;		/* due callbacks the budget pushed to a
+					 * later batch */
+	guint64 n_over_budget;		/* batches cut short by the budget */
+	guint   n_pending;		/* callbacks waiting to run */
+	gint64  max_batch_usec;
+	gint64  max_lateness_usec;	/* longest a due callback waited */
+	gint64  total_lateness_usec;	/* over n_callbacks, for the mean */
+} GPerlSchedulerStats;
+
+#define PERL_SCHEDULER_DEFAULT_BUDGET	4000	/* microseconds */
+
+/*
+=item GPerlScheduler * perl_scheduler_new (GMainContext * context, gint64 budget_usec)
+
+A scheduler dispatching in I<context>, NULL for the default one, whose
+batches stop starting callbacks once they have run for I<budget_usec>
+microseconds.  A batch always runs at least one callback.
+
+=item GPerlScheduler * perl_scheduler_get_default (void)
+
+The scheduler for the default main context, with the default budget.
+
+=item void perl_scheduler_destroy (GPerlScheduler * scheduler)
+
+Detach the scheduler and drop every pending callback.
+
+=item void perl_scheduler_set_budget (GPerlScheduler * scheduler, gint64 budget_usec)
+
+=item gint64 perl_scheduler_get_budget (GPerlScheduler * scheduler)
+
+=cut
+*/
+GPerlScheduler * perl_scheduler_new (GMainContext * context,
+                                     gint64         budget_usec);
+GPerlScheduler * perl_scheduler_get_default (void);
+void             perl_scheduler_destroy (GPerlScheduler * scheduler);
+void             perl_scheduler_set_budget (GPerlScheduler * scheduler,
+                                            gint64           budget_usec);
+gint64           perl_scheduler_get_budget (GPerlScheduler * scheduler);
+
+/*
+=item guint perl_scheduler_add (GPerlScheduler * scheduler, gint priority, guint interval, SV * callback, SV * data)
+
+Schedule I<callback> to be called with I<data>, if defined, as its only
+argument: as an idle callback if I<interval> is 0, otherwise every
+I<interval> milliseconds.  Returns an id for C<perl_scheduler_remove>.
+
+=item gboolean perl_scheduler_remove (GPerlScheduler * scheduler, guint id)
+
+Unschedule a callback; a callback may remove itself.  The callback and
+its data are released right away, or when it returns if it is running.
+Returns false if I<id> is not scheduled.
+
+=item void perl_scheduler_get_stats (GPerlScheduler * scheduler, GPerlSchedulerStats * stats, gboolean reset)
+
+Copy the counters into I<stats>, and zero them afterwards if I<reset>
+is true.  I<n_pending> is never reset.
+
+=cut
+*/
+guint    perl_scheduler_add (GPerlScheduler * scheduler,
+                             gint             priority,
+                             guint            interval,
+                             SV             * callback,
+                             SV             * data);
+gboolean perl_scheduler_remove (GPerlScheduler * scheduler, guint id);
+void     perl_scheduler_get_stats (GPerlScheduler      * scheduler,
+                                   GPerlSchedulerStats * stats,
+                                   gboolean              reset);
+
+#endif /* 2.28.0 */
+
+#endif /* __PERL_SCHEDULER_H__ */
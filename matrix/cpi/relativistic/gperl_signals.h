@@ -0,0 +1,64 @@
+#ifndef __PERL_SIGNALS_H__
+#define __PERL_SIGNALS_H__
+
+#include "gperl.h"
+
+/*
+ * cached signal introspection.
+ *
+ * signal queries never change while a type is loaded, so they are
+ * computed once per (instance type, signal id) and handed out from then
+ * on.  newSVGSignalQuery and newSVGSignalInvocationHint return references
+ * to shared, read-only hashes; custom marshallers that only need the
+ * parameter types can use the plain C signature instead and never touch
+ * perl data at all.
+ */
+
+/*
+=item GPerlSignalSignature
+
+ signal_id           the signal
+ signal_name         its canonical name
+ itype               the type that defined it
+ flags               as given to g_signal_new
+ return_type         with G_SIGNAL_TYPE_STATIC_SCOPE stripped
+ n_params            number of parameters, not counting the instance
+ param_types         with G_SIGNAL_TYPE_STATIC_SCOPE stripped
+ param_fundamentals  G_TYPE_FUNDAMENTAL of each entry in param_types,
+                     handy for switch statements
+ static_scope        bit i set if parameter i was flagged as static scope;
+                     only the first 32 parameters are recorded
+
+=cut
+*/
+typedef struct {
+	guint          signal_id;
+	const char   * signal_name;
+	GType          itype;
+	GSignalFlags   flags;
+	GType          return_type;
+	guint          n_params;
+	const GType  * param_types;
+	const GType  * param_fundamentals;
+	guint32        static_scope;
+} GPerlSignalSignature;
+
+/*
+=item const GPerlSignalSignature * perl_signal_get_signature (GType instance_type, guint signal_id)
+
+The cached signature of I<signal_id> as seen from I<instance_type>, or NULL
+if there is no such signal.  The descriptor stays valid until the type is
+invalidated; it may be used from any thread.
+
+=item void perl_signal_cache_invalidate_type (GType type)
+
+Drop every cached query and signature involving I<type>.  Call this before
+a dynamic type is unloaded.
+
+=cut
+*/
+const GPerlSignalSignature * perl_signal_get_signature (GType instance_type,
+                                                         guint signal_id);
+void perl_signal_cache_invalidate_type (GType type);
+
+#endif /* __PERL_SIGNALS_H__ */
@@ -0,0 +1,43 @@
+#ifndef __PERL_UTF8_H__
+#define __PERL_UTF8_H__
+
+#include "gperl.h"
+
+/*
+ * UTF-8 checks behind SvGChar, newSVGChar and the filename converters.
+ *
+ * every string crossing between perl and GLib used to be upgraded or
+ * flagged blindly, and filenames went through g_filename_from_utf8 and
+ * g_filename_to_utf8 even when the filename encoding is UTF-8 anyway.
+ * the converters now run a vectorized scan instead: a pure ASCII string
+ * is flagged as UTF-8 as is, anything else is validated in one pass,
+ * thirty-two bytes at a time on cpus with AVX2 and a word at a time
+ * otherwise.  long perl strings remember that they have been validated
+ * until they are next assigned to, so passing the same scalar to GLib
+ * over and over does not rescan it.
+ */
+
+/*
+=item gsize perl_utf8_ascii_span (const char * str, gsize len)
+
+The length of the leading run of ASCII bytes in the I<len> bytes at
+I<str>; I<len> if all of them are ASCII.
+
+=item gboolean perl_utf8_validate (const char * str, gsize len, gboolean * is_ascii)
+
+Whether the I<len> bytes at I<str> are well-formed UTF-8: no overlong
+forms, no surrogates and nothing above U+10FFFF.  NUL bytes are allowed.
+If I<is_ascii> is not NULL it is set to whether I<str> is pure ASCII.
+
+=item gboolean perl_filename_charset_is_utf8 (void)
+
+Whether GLib's filename encoding is UTF-8, in which case the filename
+converters pass strings through untouched.  Looked up once.
+
+=cut
+*/
+gsize    perl_utf8_ascii_span (const char * str, gsize len);
+gboolean perl_utf8_validate (const char * str, gsize len, gboolean * is_ascii);
+gboolean perl_filename_charset_is_utf8 (void);
+
+#endif /* __PERL_UTF8_H__ */
@@ -0,0 +1,52 @@
+#ifndef __PERL_VARDICT_H__
+#define __PERL_VARDICT_H__
+
+#include "gperl.h"
+
+#if GLIB_CHECK_VERSION (2, 24, 0)
+
+/*
+ * fast paths between perl hashes and "a{sv}" dictionaries.
+ *
+ * perl_vardict_from_hv serializes a hash straight into GVariant's wire
+ * format: one pass works out the size and framing of every entry, a
+ * second writes them into a buffer of exactly that size.  no
+ * GVariantDict, GVariantBuilder or per-value GVariant is created along
+ * the way.
+ *
+ * perl_vardict_new_lazy_hash goes the other way without decoding
+ * anything up front: it returns a reference to a read-only tied hash
+ * that indexes the keys on first use and converts a value only when it
+ * is fetched.
+ */
+
+/*
+=item GVariant * perl_vardict_from_hv (HV * hv)
+
+Serialize I<hv> as a new floating "a{sv}" variant.  Values map as follows,
+and anything else croaks:
+
+ integer                "x", or "t" if it only fits unsigned
+ floating point number  "d"
+ string                 "s"
+ Glib::Variant object   the variant, as is
+ unblessed hash ref     a nested "a{sv}"
+
+A scalar counts as a number only if it has never been used as a string,
+the same rule JSON serializers follow.
+
+=item SV * perl_vardict_new_lazy_hash (GVariant * dict)
+
+A reference to a tied hash over the "a{sv}" variant I<dict>, which must
+not be floating.  Fetching a key converts basic types to perl scalars,
+nested "a{sv}" to another lazy hash, and anything else to a
+Glib::Variant.  The hash is read-only.
+
+=cut
+*/
+GVariant * perl_vardict_from_hv (HV * hv);
+SV * perl_vardict_new_lazy_hash (GVariant * dict);
+
+#endif /* 2.24.0 */
+
+#endif /* __PERL_VARDICT_H__ */
@@ -0,0 +1,74 @@
+#ifndef __PERL_XSUBS_H__
+#define __PERL_XSUBS_H__
+
+#include <glib.h>
+
+/*
+ * compiled index of the XSUBs listed in _Deparsed_XSubs.pm.
+ *
+ * the source file is a few hundred "package Foo { sub bar($$) ; ... }"
+ * blocks; parsing it for every query is what makes editor and lint runs
+ * slow.  perl_xsub_index_compile turns it into a flat binary file holding
+ * an interned string pool, a package table, and the sub entries laid out in
+ * the slot order of a minimal perfect hash over "Package::sub".  opening an
+ * index just maps the file, and a lookup is two hash evaluations and one
+ * string compare, all on the mapped pages.
+ *
+ * the file is written in host byte order and refused on a host of the
+ * other order; indexes are cheap to rebuild.
+ */
+
+typedef struct _GPerlXSubIndex GPerlXSubIndex;
+
+/*
+=item gboolean perl_xsub_index_compile (const char * source, const char * output, GError ** error)
+
+Parse the deparsed XSUB listing in I<source> and write its index to
+I<output>, replacing any existing file atomically.
+
+=cut
+*/
+gboolean perl_xsub_index_compile (const char  * source,
+                                   const char  * output,
+                                   GError     ** error);
+
+/*
+=item GPerlXSubIndex * perl_xsub_index_open (const char * filename, GError ** error)
+
+=item void perl_xsub_index_close (GPerlXSubIndex * index)
+
+Map an index produced by C<perl_xsub_index_compile>.  The file is checked
+for consistency once, here, so lookups need no further bounds checks.
+
+=cut
+*/
+GPerlXSubIndex * perl_xsub_index_open  (const char      * filename,
+                                         GError         ** error);
+void             perl_xsub_index_close (GPerlXSubIndex  * index);
+
+/*
+=item gboolean perl_xsub_index_lookup (const GPerlXSubIndex * index, const char * package, const char * sub, const char ** prototype)
+
+=item gboolean perl_xsub_index_lookup_name (const GPerlXSubIndex * index, const char * full_name, const char ** prototype)
+
+Whether the XSUB exists, given either as separate package and sub names or
+as "Package::sub".  If it does and I<prototype> is not NULL, it is set to
+the prototype string, which points into the mapping, or to NULL if the sub
+was declared without one.
+
+=cut
+*/
+gboolean perl_xsub_index_lookup      (const GPerlXSubIndex  * index,
+                                       const char            * package,
+                                       const char            * sub,
+                                       const char           ** prototype);
+gboolean perl_xsub_index_lookup_name (const GPerlXSubIndex  * index,
+                                       const char            * full_name,
+                                       const char           ** prototype);
+
+guint        perl_xsub_index_get_n_subs     (const GPerlXSubIndex * index);
+guint        perl_xsub_index_get_n_packages (const GPerlXSubIndex * index);
+const char * perl_xsub_index_get_package    (const GPerlXSubIndex * index,
+                                              guint                  i);
+
+#endif /* __PERL_XSUBS_H__ */
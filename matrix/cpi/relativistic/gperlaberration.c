@@ -0,0 +1,327 @@
+/*
+ * aberration / Doppler lookup tables; see gperl_aberration.h.
+ *
+ * there is no build step in this tree that could emit the tables as C
+ * source, so they are computed once at runtime instead: the default table
+ * is 257 x 513 exact evaluations, a few milliseconds, paid on first use.
+ */
+
+#include <math.h>
+
+#include "gperl_aberration.h"
+
+typedef struct {
+	gdouble theta;
+	gdouble doppler;
+} Sample;
+
+struct _GPerlAberrationTable {
+	gdouble beta_max;
+	gdouble rapidity_max;
+	guint   n_rapidity;	/* cells; there is one more row of samples */
+	guint   n_angle;
+	gdouble inv_rapidity_step;
+	gdouble inv_angle_step;
+	gdouble angle_error;
+	gdouble doppler_error;
+	Sample * samples;	/* (n_rapidity + 1) rows of (n_angle + 1) */
+};
+
+/*
+ * --- exact formulas ---------------------------------------------------------
+ */
+
+static void
+exact_from_rapidity (gdouble eta, gdouble theta0, gdouble * theta, gdouble * doppler)
+{
+	*theta = 2.0 * atan (exp (-eta) * tan (0.5 * theta0));
+	*doppler = cosh (eta) + sinh (eta) * cos (theta0);
+}
+
+/* reduce to beta >= 0 using theta(-b, t) = pi - theta(b, pi - t) and
+ * D(-b, t) = D(b, pi - t).  returns TRUE if the result must be reflected. */
+static inline gboolean
+fold (gdouble * beta, gdouble * theta0)
+{
+	if (*theta0 < 0.0)
+		*theta0 = 0.0;
+	else if (*theta0 > G_PI)
+		*theta0 = G_PI;
+	if (*beta >= 0.0)
+		return FALSE;
+	*beta = -*beta;
+	*theta0 = G_PI - *theta0;
+	return TRUE;
+}
+
+static inline gdouble
+rapidity (gdouble beta)
+{
+	return 0.5 * log1p ((beta + beta) / (1.0 - beta));
+}
+
+void
+perl_aberration_exact (gdouble   beta,
+                        gdouble   theta0,
+                        gdouble * theta,
+                        gdouble * doppler)
+{
+	gboolean reflect = fold (&beta, &theta0);
+	gdouble t, d;
+
+	exact_from_rapidity (rapidity (beta), theta0, &t, &d);
+	if (theta)
+		*theta = reflect ? G_PI - t : t;
+	if (doppler)
+		*doppler = d;
+}
+
+/* the table index is a cast from beta and theta0, so anything that would
+ * not land inside the table is turned away first. */
+static inline gboolean
+in_domain (gdouble beta, gdouble theta0)
+{
+	return fabs (beta) < 1.0 && !isnan (theta0);
+}
+
+static inline void
+out_of_domain (gdouble * theta, gdouble * doppler)
+{
+	if (theta)
+		*theta = NAN;
+	if (doppler)
+		*doppler = NAN;
+}
+
+/*
+ * --- tables -----------------------------------------------------------------
+ */
+
+#define ROW(table, i)	((table)->samples + (gsize) (i) * ((table)->n_angle + 1))
+
+/* interpolate along theta0 in row i, then blend with row i + 1. */
+static inline void
+interpolate (const GPerlAberrationTable * table,
+             guint i, gdouble fu, gdouble theta0,
+             gdouble * theta, gdouble * doppler)
+{
+	gdouble v = theta0 * table->inv_angle_step;
+	guint j = (guint) v;
+	const Sample * a, * b;
+	gdouble fv, t0, t1, d0, d1;
+
+	if (j >= table->n_angle)
+		j = table->n_angle - 1;
+	fv = v - j;
+	a = ROW (table, i) + j;
+	b = ROW (table, i + 1) + j;
+
+	t0 = a[0].theta + fv * (a[1].theta - a[0].theta);
+	t1 = b[0].theta + fv * (b[1].theta - b[0].theta);
+	d0 = a[0].doppler + fv * (a[1].doppler - a[0].doppler);
+	d1 = b[0].doppler + fv * (b[1].doppler - b[0].doppler);
+	*theta = t0 + fu * (t1 - t0);
+	*doppler = d0 + fu * (d1 - d0);
+}
+
+static inline void
+locate_row (const GPerlAberrationTable * table, gdouble eta, guint * i, gdouble * fu)
+{
+	gdouble u = eta * table->inv_rapidity_step;
+	*i = (guint) u;
+	if (*i >= table->n_rapidity)
+		*i = table->n_rapidity - 1;
+	*fu = u - *i;
+}
+
+GPerlAberrationTable *
+perl_aberration_table_new (gdouble beta_max,
+                            guint   n_rapidity,
+                            guint   n_angle)
+{
+	GPerlAberrationTable * table;
+	gdouble eta_step, angle_step;
+	guint i, j;
+
+	if (!(beta_max > 0.0 && beta_max < 1.0) || !n_rapidity || !n_angle)
+		return NULL;
+
+	table = g_new0 (GPerlAberrationTable, 1);
+	table->beta_max = beta_max;
+	table->rapidity_max = rapidity (beta_max);
+	table->n_rapidity = n_rapidity;
+	table->n_angle = n_angle;
+	eta_step = table->rapidity_max / n_rapidity;
+	angle_step = G_PI / n_angle;
+	table->inv_rapidity_step = 1.0 / eta_step;
+	table->inv_angle_step = 1.0 / angle_step;
+	table->samples = g_new (Sample, (gsize) (n_rapidity + 1) * (n_angle + 1));
+
+	for (i = 0 ; i <= n_rapidity ; i++) {
+		Sample * row = ROW (table, i);
+		for (j = 0 ; j <= n_angle ; j++)
+			exact_from_rapidity (i * eta_step, j * angle_step,
+			                     &row[j].theta, &row[j].doppler);
+	}
+
+	/* bilinear error peaks near the middle of a cell; measure it there. */
+	for (i = 0 ; i < n_rapidity ; i++) {
+		for (j = 0 ; j < n_angle ; j++) {
+			gdouble eta = (i + 0.5) * eta_step;
+			gdouble theta0 = (j + 0.5) * angle_step;
+			gdouble t, d, te, de;
+
+			exact_from_rapidity (eta, theta0, &te, &de);
+			interpolate (table, i, 0.5, theta0, &t, &d);
+			table->angle_error = MAX (table->angle_error, fabs (t - te));
+			table->doppler_error = MAX (table->doppler_error,
+			                            fabs (d - de) / de);
+		}
+	}
+
+	return table;
+}
+
+void
+perl_aberration_table_free (GPerlAberrationTable * table)
+{
+	if (!table)
+		return;
+	g_free (table->samples);
+	g_free (table);
+}
+
+const GPerlAberrationTable *
+perl_aberration_table_default (void)
+{
+	static gsize table = 0;
+	if (g_once_init_enter (&table))
+		g_once_init_leave (&table, (gsize) perl_aberration_table_new (0.99, 256, 512));
+	return (const GPerlAberrationTable *) table;
+}
+
+void
+perl_aberration_table_get_error (const GPerlAberrationTable * table,
+                                  gdouble                    * angle_error,
+                                  gdouble                    * doppler_error)
+{
+	g_return_if_fail (table != NULL);
+	if (angle_error)
+		*angle_error = table->angle_error;
+	if (doppler_error)
+		*doppler_error = table->doppler_error;
+}
+
+void
+perl_aberration_lookup (const GPerlAberrationTable * table,
+                         gdouble                      beta,
+                         gdouble                      theta0,
+                         gdouble                    * theta,
+                         gdouble                    * doppler)
+{
+	gboolean reflect;
+	gdouble t, d, fu;
+	guint i;
+
+	if (!in_domain (beta, theta0)) {
+		out_of_domain (theta, doppler);
+		return;
+	}
+	reflect = fold (&beta, &theta0);
+	if (beta > table->beta_max) {
+		exact_from_rapidity (rapidity (beta), theta0, &t, &d);
+	} else {
+		locate_row (table, rapidity (beta), &i, &fu);
+		interpolate (table, i, fu, theta0, &t, &d);
+	}
+	if (theta)
+		*theta = reflect ? G_PI - t : t;
+	if (doppler)
+		*doppler = d;
+}
+
+void
+perl_aberration_lookup_angles (const GPerlAberrationTable * table,
+                                gdouble                      beta,
+                                const gdouble              * theta0,
+                                gdouble                    * theta,
+                                gdouble                    * doppler,
+                                gsize                        n)
+{
+	gboolean reflect = beta < 0.0;
+	gdouble speed = fabs (beta), fu;
+	guint i;
+	gsize k;
+
+	if (!(speed < 1.0)) {
+		for (k = 0 ; k < n ; k++)
+			out_of_domain (theta ? theta + k : NULL,
+			               doppler ? doppler + k : NULL);
+		return;
+	}
+	if (speed > table->beta_max) {
+		for (k = 0 ; k < n ; k++)
+			perl_aberration_exact (beta, theta0[k],
+			                        theta ? theta + k : NULL,
+			                        doppler ? doppler + k : NULL);
+		return;
+	}
+
+	locate_row (table, rapidity (speed), &i, &fu);
+	for (k = 0 ; k < n ; k++) {
+		gdouble b = beta, t0 = theta0[k], t, d;
+		if (isnan (t0)) {
+			out_of_domain (theta ? theta + k : NULL,
+			               doppler ? doppler + k : NULL);
+			continue;
+		}
+		fold (&b, &t0);
+		interpolate (table, i, fu, t0, &t, &d);
+		if (theta)
+			theta[k] = reflect ? G_PI - t : t;
+		if (doppler)
+			doppler[k] = d;
+	}
+}
+
+void
+perl_aberration_lookup_array (const GPerlAberrationTable * table,
+                               const gdouble              * beta,
+                               const gdouble              * theta0,
+                               gdouble                    * theta,
+                               gdouble                    * doppler,
+                               gsize                        n)
+{
+	/* the row, and the log1p behind it, is only worked out again when
+	 * the speed changes, so runs of one speed cost what
+	 * perl_aberration_lookup_angles does. */
+	gdouble speed = NAN, eta = 0.0, fu = 0.0;
+	guint i = 0;
+	gsize k;
+
+	for (k = 0 ; k < n ; k++) {
+		gdouble b = beta[k], t0 = theta0[k], t, d;
+		gboolean reflect;
+
+		if (!in_domain (b, t0)) {
+			out_of_domain (theta ? theta + k : NULL,
+			               doppler ? doppler + k : NULL);
+			continue;
+		}
+		reflect = fold (&b, &t0);
+		if (b != speed) {
+			speed = b;
+			eta = rapidity (b);
+			if (b <= table->beta_max)
+				locate_row (table, eta, &i, &fu);
+		}
+		if (b > table->beta_max)
+			exact_from_rapidity (eta, t0, &t, &d);
+		else
+			interpolate (table, i, fu, t0, &t, &d);
+		if (theta)
+			theta[k] = reflect ? G_PI - t : t;
+		if (doppler)
+			doppler[k] = d;
+	}
+}
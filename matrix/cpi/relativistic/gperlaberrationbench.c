@@ -0,0 +1,127 @@
+/*
+ * accuracy and throughput of the aberration tables against the exact
+ * formulas.
+ *
+ *   gperlaberrationbench [SAMPLES [BETA_MAX [N_RAPIDITY [N_ANGLE]]]]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gperl_aberration.h"
+
+#define BATCH	4096
+#define SUB	8	/* dense sweep points per cell and axis */
+
+static gdouble
+seconds (gint64 start)
+{
+	return (g_get_monotonic_time () - start) / 1e6;
+}
+
+/* the build-time bound is taken at cell centres only; walk a grid SUB
+ * times finer than the table, edges included, to check it holds. */
+static void
+dense_sweep (const GPerlAberrationTable * table, gdouble beta_max,
+             guint n_rapidity, guint n_angle,
+             gdouble * angle_error, gdouble * doppler_error)
+{
+	gdouble eta_max = atanh (beta_max);
+	guint i, j;
+
+	*angle_error = *doppler_error = 0.0;
+	for (i = 0 ; i <= n_rapidity * SUB ; i++) {
+		gdouble beta = tanh (eta_max * i / (n_rapidity * SUB));
+		for (j = 0 ; j <= n_angle * SUB ; j++) {
+			gdouble theta0 = G_PI * j / (n_angle * SUB);
+			gdouble t, d, te, de;
+			perl_aberration_exact (beta, theta0, &te, &de);
+			perl_aberration_lookup (table, beta, theta0, &t, &d);
+			*angle_error = MAX (*angle_error, fabs (t - te));
+			*doppler_error = MAX (*doppler_error, fabs (d - de) / de);
+		}
+	}
+}
+
+int
+main (int argc, char ** argv)
+{
+	gsize samples = argc > 1 ? strtoul (argv[1], NULL, 10) : 10000000;
+	gdouble beta_max = argc > 2 ? atof (argv[2]) : 0.99;
+	guint n_rapidity = argc > 3 ? atoi (argv[3]) : 256;
+	guint n_angle = argc > 4 ? atoi (argv[4]) : 512;
+	GPerlAberrationTable * table;
+	gdouble beta[BATCH], one_beta[BATCH], theta0[BATCH];
+	gdouble theta[BATCH], doppler[BATCH];
+	gdouble exact_theta[BATCH], exact_doppler[BATCH];
+	gdouble angle_bound, doppler_bound;
+	gdouble angle_error = 0.0, doppler_error = 0.0;
+	gdouble dense_angle, dense_doppler;
+	gdouble t_exact = 0.0, t_table = 0.0, t_one = 0.0, t_angles = 0.0;
+	gsize done, k;
+	gint64 start;
+
+	table = perl_aberration_table_new (beta_max, n_rapidity, n_angle);
+	if (!table) {
+		fprintf (stderr, "bad table parameters\n");
+		return 1;
+	}
+	perl_aberration_table_get_error (table, &angle_bound, &doppler_bound);
+
+	srand (1);
+	for (done = 0 ; done < samples ; done += BATCH) {
+		for (k = 0 ; k < BATCH ; k++) {
+			beta[k] = beta_max * (2.0 * rand () / RAND_MAX - 1.0);
+			theta0[k] = G_PI * rand () / RAND_MAX;
+		}
+		for (k = 0 ; k < BATCH ; k++)
+			one_beta[k] = beta[0];
+
+		start = g_get_monotonic_time ();
+		for (k = 0 ; k < BATCH ; k++)
+			perl_aberration_exact (beta[k], theta0[k],
+			                        &exact_theta[k], &exact_doppler[k]);
+		t_exact += seconds (start);
+
+		start = g_get_monotonic_time ();
+		perl_aberration_lookup_array (table, beta, theta0,
+		                               theta, doppler, BATCH);
+		t_table += seconds (start);
+
+		for (k = 0 ; k < BATCH ; k++) {
+			angle_error = MAX (angle_error,
+			                   fabs (theta[k] - exact_theta[k]));
+			doppler_error = MAX (doppler_error,
+			                     fabs (doppler[k] - exact_doppler[k])
+			                     / exact_doppler[k]);
+		}
+
+		start = g_get_monotonic_time ();
+		perl_aberration_lookup_array (table, one_beta, theta0,
+		                               theta, doppler, BATCH);
+		t_one += seconds (start);
+
+		start = g_get_monotonic_time ();
+		perl_aberration_lookup_angles (table, beta[0], theta0,
+		                                theta, doppler, BATCH);
+		t_angles += seconds (start);
+	}
+
+	printf ("table %u x %u up to beta %g\n", n_rapidity, n_angle, beta_max);
+	printf ("  build-time bound: angle %.3g rad, doppler %.3g relative\n",
+	        angle_bound, doppler_bound);
+	printf ("  observed error:   angle %.3g rad, doppler %.3g relative\n",
+	        angle_error, doppler_error);
+	dense_sweep (table, beta_max, n_rapidity, n_angle,
+	             &dense_angle, &dense_doppler);
+	printf ("  dense sweep:      angle %.3g rad, doppler %.3g relative\n",
+	        dense_angle, dense_doppler);
+	printf ("exact         %8.1f Msamples/s\n", done / t_exact / 1e6);
+	printf ("table, array  %8.1f Msamples/s\n", done / t_table / 1e6);
+	printf ("  one speed    %8.1f Msamples/s\n", done / t_one / 1e6);
+	printf ("table, angles %8.1f Msamples/s\n", done / t_angles / 1e6);
+
+	perl_aberration_table_free (table);
+	return 0;
+}
@@ -0,0 +1,242 @@
+/*
+ * per-type wrapper accounting; see gperl_accounting.h.
+ */
+
+#include "gperl_accounting.h"
+
+typedef struct {
+	GPerlWrapperStats stats;
+	gboolean          have_size;
+	gsize             instance_size;
+} TypeEntry;
+
+static volatile gint enabled = 0;
+static guint sample_every = 0;
+static guint until_sample = 0;
+static GHashTable * types = NULL;	/* GType -> TypeEntry */
+static GHashTable * sampled = NULL;	/* wrapper -> interned site */
+G_LOCK_DEFINE_STATIC (accounting);
+
+static void
+type_entry_free (gpointer data)
+{
+	TypeEntry * entry = data;
+	g_hash_table_destroy (entry->stats.sites);
+	g_free (entry);
+}
+
+/* call with the lock held. */
+static TypeEntry *
+get_entry (GType type)
+{
+	TypeEntry * entry = g_hash_table_lookup (types, (gpointer) type);
+	if (!entry) {
+		entry = g_new0 (TypeEntry, 1);
+		entry->stats.type = type;
+		/* the sites are interned, so compare pointers */
+		entry->stats.sites = g_hash_table_new (g_direct_hash,
+		                                       g_direct_equal);
+		g_hash_table_insert (types, (gpointer) type, entry);
+	}
+	return entry;
+}
+
+/* call with the lock held. */
+static gsize
+wrapper_bytes (TypeEntry * entry, gsize bytes)
+{
+	if (bytes)
+		return bytes;
+	if (!entry->have_size) {
+		if (G_TYPE_IS_INSTANTIATABLE (entry->stats.type)) {
+			GTypeQuery query;
+			g_type_query (entry->stats.type, &query);
+			entry->instance_size = query.instance_size;
+		}
+		entry->have_size = TRUE;
+	}
+	return entry->instance_size;
+}
+
+/* the perl statement being run, which for a wrapper is the code that
+ * asked for it. */
+static const char *
+current_site (void)
+{
+	dTHX;
+	const char * file;
+
+	if (!PL_curcop)
+		return g_intern_static_string ("(unknown)");
+	file = CopFILE (PL_curcop);
+	return g_intern_string (form ("%s:%" UVuf, file ? file : "(unknown)",
+	                              (UV) CopLINE (PL_curcop)));
+}
+
+/* call with the lock held. */
+static void
+site_adjust (TypeEntry * entry, const char * site, gint delta)
+{
+	guint n = GPOINTER_TO_UINT (g_hash_table_lookup (entry->stats.sites,
+	                                                 site));
+	n += delta;
+	if (n)
+		g_hash_table_insert (entry->stats.sites, (gpointer) site,
+		                     GUINT_TO_POINTER (n));
+	else
+		g_hash_table_remove (entry->stats.sites, site);
+}
+
+/*
+ * --- switching --------------------------------------------------------------
+ */
+
+void
+perl_wrapper_accounting_enable (guint every)
+{
+	G_LOCK (accounting);
+	if (!types) {
+		types = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+		                               NULL, type_entry_free);
+		sampled = g_hash_table_new (g_direct_hash, g_direct_equal);
+	}
+	sample_every = every;
+	until_sample = every;
+	G_UNLOCK (accounting);
+
+	g_atomic_int_set (&enabled, 1);
+}
+
+void
+perl_wrapper_accounting_disable (void)
+{
+	g_atomic_int_set (&enabled, 0);
+
+	G_LOCK (accounting);
+	if (types) {
+		g_hash_table_destroy (types);
+		g_hash_table_destroy (sampled);
+		types = sampled = NULL;
+	}
+	G_UNLOCK (accounting);
+}
+
+gboolean
+perl_wrapper_accounting_is_enabled (void)
+{
+	return g_atomic_int_get (&enabled);
+}
+
+/*
+ * --- hooks ------------------------------------------------------------------
+ */
+
+void
+perl_wrapper_accounting_created (GType         type,
+                                 gconstpointer wrapper,
+                                 gsize         bytes)
+{
+	TypeEntry * entry;
+
+	if (!g_atomic_int_get (&enabled))
+		return;
+
+	G_LOCK (accounting);
+	if (types) {
+		entry = get_entry (type);
+		entry->stats.n_live++;
+		entry->stats.n_created++;
+		entry->stats.bytes += wrapper_bytes (entry, bytes);
+
+		if (sample_every && --until_sample == 0) {
+			const char * site = current_site ();
+			until_sample = sample_every;
+			g_hash_table_insert (sampled, (gpointer) wrapper,
+			                     (gpointer) site);
+			site_adjust (entry, site, 1);
+		}
+	}
+	G_UNLOCK (accounting);
+}
+
+void
+perl_wrapper_accounting_destroyed (GType         type,
+                                   gconstpointer wrapper,
+                                   gsize         bytes)
+{
+	TypeEntry * entry;
+	const char * site;
+
+	if (!g_atomic_int_get (&enabled))
+		return;
+
+	G_LOCK (accounting);
+	if (types) {
+		entry = get_entry (type);
+		entry->stats.n_live--;
+		entry->stats.n_destroyed++;
+		entry->stats.bytes -= wrapper_bytes (entry, bytes);
+
+		if (g_hash_table_size (sampled) &&
+		    (site = g_hash_table_lookup (sampled, wrapper))) {
+			g_hash_table_remove (sampled, wrapper);
+			site_adjust (entry, site, -1);
+		}
+	}
+	G_UNLOCK (accounting);
+}
+
+void
+perl_wrapper_accounting_toggled (GType type, gboolean is_last_ref)
+{
+	if (!g_atomic_int_get (&enabled))
+		return;
+
+	G_LOCK (accounting);
+	if (types)
+		get_entry (type)->stats.n_pinned += is_last_ref ? -1 : 1;
+	G_UNLOCK (accounting);
+}
+
+/*
+ * --- snapshots --------------------------------------------------------------
+ */
+
+GPerlWrapperStats *
+perl_wrapper_accounting_snapshot (guint * n_types)
+{
+	GPerlWrapperStats * stats;
+	GHashTableIter iter, site_iter;
+	gpointer value, site, count;
+	guint i = 0;
+
+	G_LOCK (accounting);
+	*n_types = types ? g_hash_table_size (types) : 0;
+	stats = g_new (GPerlWrapperStats, MAX (*n_types, 1));
+	if (types) {
+		g_hash_table_iter_init (&iter, types);
+		while (g_hash_table_iter_next (&iter, NULL, &value)) {
+			TypeEntry * entry = value;
+			stats[i] = entry->stats;
+			stats[i].sites = g_hash_table_new (g_direct_hash,
+			                                   g_direct_equal);
+			g_hash_table_iter_init (&site_iter, entry->stats.sites);
+			while (g_hash_table_iter_next (&site_iter, &site, &count))
+				g_hash_table_insert (stats[i].sites, site, count);
+			i++;
+		}
+	}
+	G_UNLOCK (accounting);
+
+	return stats;
+}
+
+void
+perl_wrapper_accounting_snapshot_free (GPerlWrapperStats * stats,
+                                       guint               n_types)
+{
+	guint i;
+	for (i = 0 ; i < n_types ; i++)
+		g_hash_table_destroy (stats[i].sites);
+	g_free (stats);
+}
@@ -0,0 +1,178 @@
+/*
+ * zero-copy @ARGV bridge; see gperl_argv.h.
+ */
+
+#include <string.h>
+
+#include "gperl_argv.h"
+
+typedef struct {
+	int       argc;		/* as handed out */
+	char   ** borrowed;	/* the original argv, which the C side may
+				 * shuffle in place */
+	SV     ** svs;		/* the scalars behind borrowed, referenced */
+	guint8  * copied;	/* whether borrowed[i] is our own copy */
+} ArgvPrivy;
+
+/* everything in one block: the GPerlArgv, its privy, argv with room for
+ * the NULL terminator, then borrowed, svs and copied. */
+static GPerlArgv *
+argv_alloc (int argc)
+{
+	gsize n = argc;
+	GPerlArgv * pargv;
+	ArgvPrivy * privy;
+	char * p;
+
+	p = g_malloc (sizeof (GPerlArgv) + sizeof (ArgvPrivy)
+	              + (n + 1) * sizeof (char *)
+	              + n * sizeof (char *)
+	              + n * sizeof (SV *)
+	              + n);
+	pargv = (GPerlArgv *) p;
+	p += sizeof (GPerlArgv);
+	privy = (ArgvPrivy *) p;
+	p += sizeof (ArgvPrivy);
+	pargv->argv = (char **) p;
+	p += (n + 1) * sizeof (char *);
+	privy->borrowed = (char **) p;
+	p += n * sizeof (char *);
+	privy->svs = (SV **) p;
+	p += n * sizeof (SV *);
+	privy->copied = (guint8 *) p;
+
+	pargv->argc = privy->argc = argc;
+	pargv->privy = privy;
+	return pargv;
+}
+
+/* the scalar's own buffer where it has one that will not change under
+ * us, a copy otherwise.  perl_argv_update finds the survivors by address,
+ * so every entry needs a buffer of its own: undef gets a fresh empty
+ * string, and a buffer already handed out (copy-on-write strings share
+ * one) is copied. */
+static char *
+borrow (pTHX_ SV * sv, GHashTable * seen, guint8 * copied)
+{
+	*copied = TRUE;
+	if (!sv || !SvOK (sv))
+		return g_strdup ("");
+	/* numbers, magic and overloading produce fresh strings */
+	if (!SvPOK (sv) || SvGMAGICAL (sv) || SvAMAGIC (sv))
+		return g_strdup (SvPV_nolen (sv));
+	if (g_hash_table_lookup (seen, SvPVX (sv)))
+		return g_strdup (SvPVX (sv));
+	g_hash_table_insert (seen, SvPVX (sv), SvPVX (sv));
+	*copied = FALSE;
+	return SvPVX (sv);
+}
+
+GPerlArgv *
+perl_argv_new (void)
+{
+	dTHX;
+	AV * ARGV = get_av ("ARGV", GV_ADD);
+	SV * ARGV0 = get_sv ("0", GV_ADD);
+	GPerlArgv * pargv;
+	ArgvPrivy * privy;
+	GHashTable * seen;
+	int len, i;
+
+	len = av_len (ARGV) + 1;
+	pargv = argv_alloc (len + 1);
+	privy = pargv->privy;
+	seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	privy->svs[0] = SvREFCNT_inc_simple (ARGV0);
+	privy->borrowed[0] = borrow (aTHX_ ARGV0, seen, &privy->copied[0]);
+	for (i = 0 ; i < len ; i++) {
+		SV ** svp = av_fetch (ARGV, i, FALSE);
+		SV * sv = svp ? *svp : NULL;
+		privy->svs[i + 1] = SvREFCNT_inc_simple (sv);
+		privy->borrowed[i + 1] = borrow (aTHX_ sv, seen,
+		                                 &privy->copied[i + 1]);
+	}
+	g_hash_table_destroy (seen);
+
+	memcpy (pargv->argv, privy->borrowed, (len + 1) * sizeof (char *));
+	pargv->argv[len + 1] = NULL;
+	return pargv;
+}
+
+void
+perl_argv_update (GPerlArgv * pargv)
+{
+	dTHX;
+	ArgvPrivy * privy = pargv->privy;
+	AV * ARGV;
+	SV ** args;
+	int i, next = 1;
+
+	if (pargv->argc == privy->argc &&
+	    !memcmp (pargv->argv, privy->borrowed,
+	             privy->argc * sizeof (char *)))
+		return;
+
+	args = perl_alloc_temp (MAX (pargv->argc, 1) * sizeof (SV *));
+	for (i = 1 ; i < pargv->argc ; i++) {
+		char * arg = pargv->argv[i];
+		int k;
+
+		/* parsers drop entries but keep the rest in order, so the
+		 * next survivor is found by scanning forward */
+		for (k = next ; k < privy->argc ; k++)
+			if (privy->borrowed[k] == arg)
+				break;
+
+		if (k < privy->argc) {
+			next = k + 1;
+			args[i] = privy->svs[k]
+			        ? SvREFCNT_inc_simple_NN (privy->svs[k])
+			        : newSV (0);
+		} else {
+			args[i] = newSVpv (arg ? arg : "", 0);
+		}
+	}
+
+	ARGV = get_av ("ARGV", GV_ADD);
+	av_clear (ARGV);
+	if (pargv->argc > 1)
+		av_extend (ARGV, pargv->argc - 2);
+	for (i = 1 ; i < pargv->argc ; i++)
+		av_store (ARGV, i - 1, args[i]);
+}
+
+void
+perl_argv_free (GPerlArgv * pargv)
+{
+	dTHX;
+	ArgvPrivy * privy = pargv->privy;
+	int i;
+
+	for (i = 0 ; i < privy->argc ; i++) {
+		SvREFCNT_dec (privy->svs[i]);
+		if (privy->copied[i])
+			g_free (privy->borrowed[i]);
+	}
+	g_free (pargv);
+}
+
+#if GLIB_CHECK_VERSION (2, 6, 0)
+
+gboolean
+perl_option_context_parse (GOptionContext  * context,
+                           GError         ** error)
+{
+	GPerlArgv * pargv = perl_argv_new ();
+	gboolean ok;
+
+	ok = g_option_context_parse (context, &pargv->argc, &pargv->argv,
+	                             error);
+	if (ok)
+		perl_argv_update (pargv);
+	perl_argv_free (pargv);
+
+	return ok;
+}
+
+#endif /* 2.6.0 */
@@ -0,0 +1,408 @@
+/*
+ * pooled, copy-on-write boxed wrappers; see gperl_boxed_pool.h.
+ */
+
+#include "gperl_boxed_pool.h"
+#include "gperl_accounting.h"
+
+/* how many freed wrappers each type keeps around */
+#define MAX_FREE_WRAPPERS 1024
+
+typedef struct _Pool Pool;
+typedef struct _Wrapper Wrapper;
+
+struct _Pool {
+	GType               type;
+	gboolean            pooled;	/* registered with the pooled class */
+	GPerlBoxedPoolStats stats;
+	Wrapper           * free_list;
+};
+
+/* a thread's borrow scopes.  a borrowed boxed is only valid on the thread
+ * that lent it, so every thread keeps its own stack. */
+typedef struct {
+	GPtrArray * borrowed;	/* Wrapper, innermost scope last */
+	GArray    * starts;	/* guint index into borrowed */
+} Scopes;
+
+struct _Wrapper {
+	Pool     * pool;
+	gpointer   boxed;
+	gboolean   own;
+	Scopes   * lender;	/* the scopes holding it while borrowed */
+	Wrapper  * next_free;
+};
+
+static void scopes_free (gpointer data);
+
+static GHashTable * pools = NULL;	/* GType -> Pool */
+static GPrivate scopes_key = G_PRIVATE_INIT (scopes_free);
+G_LOCK_DEFINE_STATIC (pools);
+
+/* call with the lock held. */
+static Pool *
+get_pool (GType type)
+{
+	Pool * pool;
+
+	if (!pools)
+		pools = g_hash_table_new (g_direct_hash, g_direct_equal);
+	pool = g_hash_table_lookup (pools, (gpointer) type);
+	if (!pool) {
+		pool = g_new0 (Pool, 1);
+		pool->type = type;
+		g_hash_table_insert (pools, (gpointer) type, pool);
+	}
+	return pool;
+}
+
+/* call with the lock held. */
+static Wrapper *
+wrapper_alloc (GType type)
+{
+	Pool * pool = get_pool (type);
+	Wrapper * wrapper = pool->free_list;
+
+	if (wrapper) {
+		pool->free_list = wrapper->next_free;
+		pool->stats.n_free--;
+		pool->stats.n_reused++;
+	} else {
+		wrapper = g_new (Wrapper, 1);
+	}
+	wrapper->pool = pool;
+	wrapper->next_free = NULL;
+	pool->stats.n_wraps++;
+	pool->stats.n_live++;
+	return wrapper;
+}
+
+/* call with the lock held. */
+static void
+wrapper_release (Wrapper * wrapper)
+{
+	Pool * pool = wrapper->pool;
+
+	pool->stats.n_live--;
+	if (pool->stats.n_free >= MAX_FREE_WRAPPERS) {
+		g_free (wrapper);
+		return;
+	}
+	wrapper->boxed = NULL;
+	wrapper->next_free = pool->free_list;
+	pool->free_list = wrapper;
+	pool->stats.n_free++;
+}
+
+/* call with the lock held.  borrowed wrappers almost always die in the
+ * scope that made them, so search from the newest. */
+static void
+forget_borrowed (Wrapper * wrapper)
+{
+	GPtrArray * borrowed = wrapper->lender->borrowed;
+	guint i = borrowed->len;
+	while (i-- > 0)
+		if (g_ptr_array_index (borrowed, i) == wrapper) {
+			g_ptr_array_remove_index (borrowed, i);
+			break;
+		}
+	wrapper->lender = NULL;
+}
+
+/* call with the lock held.  gives every wrapper borrowed since index start
+ * of scopes a copy of its own. */
+static void
+copy_borrowed (Scopes * scopes, guint start)
+{
+	guint i;
+
+	/* whatever perl still holds now needs a copy of its own, since the
+	 * lender is free to change or free the original once we return. */
+	for (i = start ; i < scopes->borrowed->len ; i++) {
+		Wrapper * wrapper = g_ptr_array_index (scopes->borrowed, i);
+		wrapper->boxed = g_boxed_copy (wrapper->pool->type,
+		                               wrapper->boxed);
+		wrapper->own = TRUE;
+		wrapper->lender = NULL;
+		wrapper->pool->stats.n_deferred++;
+		wrapper->pool->stats.n_copies++;
+	}
+	g_ptr_array_set_size (scopes->borrowed, start);
+}
+
+/* a thread that exits inside a scope still must not leave perl pointing
+ * at what it lent. */
+static void
+scopes_free (gpointer data)
+{
+	Scopes * scopes = data;
+
+	G_LOCK (pools);
+	copy_borrowed (scopes, 0);
+	G_UNLOCK (pools);
+	g_ptr_array_free (scopes->borrowed, TRUE);
+	g_array_free (scopes->starts, TRUE);
+	g_free (scopes);
+}
+
+static Scopes *
+get_scopes (gboolean create)
+{
+	Scopes * scopes = g_private_get (&scopes_key);
+	if (!scopes && create) {
+		scopes = g_new (Scopes, 1);
+		scopes->borrowed = g_ptr_array_new ();
+		scopes->starts = g_array_new (FALSE, FALSE, sizeof (guint));
+		g_private_set (&scopes_key, scopes);
+	}
+	return scopes;
+}
+
+static SV *
+wrapper_to_sv (Wrapper * wrapper, const char * package)
+{
+	dTHX;
+	SV * sv = newSViv (PTR2IV (wrapper));
+	return sv_bless (newRV_noinc (sv), gv_stashpv (package, TRUE));
+}
+
+static Wrapper *
+sv_to_wrapper (SV * sv)
+{
+	dTHX;
+	return INT2PTR (Wrapper *, SvIV (SvRV (sv)));
+}
+
+/*
+ * --- the wrapper class -------------------------------------------------------
+ */
+
+static SV *
+pooled_wrap (GType type, const char * package, gpointer boxed, gboolean own)
+{
+	dTHX;
+	Wrapper * wrapper;
+
+	if (!boxed)
+		return &PL_sv_undef;
+
+	G_LOCK (pools);
+	wrapper = wrapper_alloc (type);
+	/* only the pooled class wraps, so the type is registered with it */
+	wrapper->pool->pooled = TRUE;
+	G_UNLOCK (pools);
+
+	wrapper->boxed = boxed;
+	wrapper->own = own;
+	wrapper->lender = NULL;
+	perl_wrapper_accounting_created (type, wrapper, sizeof (Wrapper));
+	return wrapper_to_sv (wrapper, package);
+}
+
+static gpointer
+pooled_unwrap (GType type, const char * package, SV * sv)
+{
+	dTHX;
+
+	if (!perl_sv_is_ref (sv) || !sv_derived_from (sv, package))
+		croak ("%s is not of type %s",
+		       perl_format_variable_for_output (sv), package);
+	PERL_UNUSED_VAR (type);
+	return sv_to_wrapper (sv)->boxed;
+}
+
+static void
+pooled_destroy (SV * sv)
+{
+	dTHX;
+	Wrapper * wrapper = sv_to_wrapper (sv);
+	gpointer boxed;
+	gboolean own;
+	GType type;
+
+	if (!wrapper)
+		return;
+	/* guard against a second DESTROY */
+	sv_setiv (SvRV (sv), 0);
+	/* before the wrapper can go back on the free list and be reused */
+	perl_wrapper_accounting_destroyed (wrapper->pool->type, wrapper,
+	                                   sizeof (Wrapper));
+
+	G_LOCK (pools);
+	if (wrapper->lender)
+		forget_borrowed (wrapper);
+	boxed = wrapper->boxed;
+	own = wrapper->own;
+	type = wrapper->pool->type;
+	wrapper_release (wrapper);
+	G_UNLOCK (pools);
+
+	if (own)
+		g_boxed_free (type, boxed);
+}
+
+static GPerlBoxedWrapperClass pooled_wrapper_class = {
+	pooled_wrap,
+	pooled_unwrap,
+	pooled_destroy
+};
+
+GPerlBoxedWrapperClass *
+perl_pooled_boxed_wrapper_class (void)
+{
+	return &pooled_wrapper_class;
+}
+
+void
+perl_register_pooled_boxed (GType type, const char * package)
+{
+	G_LOCK (pools);
+	get_pool (type)->pooled = TRUE;
+	G_UNLOCK (pools);
+	perl_register_boxed (type, package, &pooled_wrapper_class);
+}
+
+static gboolean
+is_pooled (GType type)
+{
+	Pool * pool;
+	gboolean pooled;
+
+	G_LOCK (pools);
+	pool = pools ? g_hash_table_lookup (pools, (gpointer) type) : NULL;
+	pooled = pool && pool->pooled;
+	G_UNLOCK (pools);
+	return pooled;
+}
+
+/*
+ * --- copy on write -----------------------------------------------------------
+ */
+
+void
+perl_boxed_borrow_begin (void)
+{
+	Scopes * scopes = get_scopes (TRUE);
+	guint start;
+
+	G_LOCK (pools);
+	start = scopes->borrowed->len;
+	g_array_append_val (scopes->starts, start);
+	G_UNLOCK (pools);
+}
+
+void
+perl_boxed_borrow_end (void)
+{
+	Scopes * scopes = get_scopes (FALSE);
+	guint start;
+
+	if (!scopes || !scopes->starts->len) {
+		g_critical ("perl_boxed_borrow_end called without a matching "
+		            "perl_boxed_borrow_begin");
+		return;
+	}
+
+	G_LOCK (pools);
+	start = g_array_index (scopes->starts, guint, scopes->starts->len - 1);
+	g_array_set_size (scopes->starts, scopes->starts->len - 1);
+	copy_borrowed (scopes, start);
+	G_UNLOCK (pools);
+}
+
+SV *
+perl_new_boxed_cow (gpointer boxed, GType type)
+{
+	dTHX;
+	const char * package;
+	Scopes * scopes;
+	Wrapper * wrapper;
+
+	if (!boxed)
+		return &PL_sv_undef;
+
+	package = perl_boxed_package_from_type (type);
+	if (!package)
+		croak ("GType %s is not registered with GPerl",
+		       g_type_name (type));
+	/* a wrapper made here must be one the type's class will unwrap */
+	if (!is_pooled (type))
+		return perl_new_boxed_copy (boxed, type);
+
+	scopes = get_scopes (FALSE);
+
+	G_LOCK (pools);
+	wrapper = wrapper_alloc (type);
+	if (scopes && scopes->starts->len) {
+		wrapper->boxed = boxed;
+		wrapper->own = FALSE;
+		wrapper->lender = scopes;
+		g_ptr_array_add (scopes->borrowed, wrapper);
+		wrapper->pool->stats.n_borrowed++;
+		G_UNLOCK (pools);
+	} else {
+		wrapper->pool->stats.n_copies++;
+		G_UNLOCK (pools);
+		wrapper->boxed = g_boxed_copy (type, boxed);
+		wrapper->own = TRUE;
+		wrapper->lender = NULL;
+	}
+
+	perl_wrapper_accounting_created (type, wrapper, sizeof (Wrapper));
+	return wrapper_to_sv (wrapper, package);
+}
+
+gpointer
+perl_boxed_make_writable (SV * sv, GType type)
+{
+	Wrapper * wrapper;
+
+	if (!is_pooled (type))
+		croak ("GType %s is not registered with the pooled boxed "
+		       "wrapper class", g_type_name (type));
+	/* validates sv through the registered unwrap. */
+	perl_get_boxed_check (sv, type);
+	wrapper = sv_to_wrapper (sv);
+
+	G_LOCK (pools);
+	if (wrapper->lender) {
+		forget_borrowed (wrapper);
+		wrapper->boxed = g_boxed_copy (wrapper->pool->type,
+		                               wrapper->boxed);
+		wrapper->own = TRUE;
+		wrapper->pool->stats.n_copies++;
+	}
+	G_UNLOCK (pools);
+
+	return wrapper->boxed;
+}
+
+/*
+ * --- accounting --------------------------------------------------------------
+ */
+
+guint
+perl_boxed_pool_get_stats (GType               ** types,
+                            GPerlBoxedPoolStats ** stats)
+{
+	GHashTableIter iter;
+	gpointer value;
+	guint n, i = 0;
+
+	G_LOCK (pools);
+	n = pools ? g_hash_table_size (pools) : 0;
+	*types = g_new (GType, n);
+	*stats = g_new (GPerlBoxedPoolStats, n);
+	if (pools) {
+		g_hash_table_iter_init (&iter, pools);
+		while (g_hash_table_iter_next (&iter, NULL, &value)) {
+			Pool * pool = value;
+			(*types)[i] = pool->type;
+			(*stats)[i] = pool->stats;
+			i++;
+		}
+	}
+	G_UNLOCK (pools);
+
+	return n;
+}
@@ -0,0 +1,655 @@
+/*
+ * zero-copy filter pipeline; see gperl_brigade.h.
+ */
+
+#include <string.h>
+
+#include "gperl_brigade.h"
+
+/*
+ * --- brigades ---------------------------------------------------------------
+ */
+
+struct _GPerlBrigade {
+	GQueue   buckets;	/* GBytes, never empty ones */
+	gsize    length;
+	gboolean eos;
+};
+
+GPerlBrigade *
+perl_brigade_new (void)
+{
+	GPerlBrigade * brigade = g_slice_new0 (GPerlBrigade);
+	g_queue_init (&brigade->buckets);
+	return brigade;
+}
+
+void
+perl_brigade_free (GPerlBrigade * brigade)
+{
+	if (!brigade)
+		return;
+	g_queue_clear_full (&brigade->buckets, (GDestroyNotify) g_bytes_unref);
+	g_slice_free (GPerlBrigade, brigade);
+}
+
+static void
+append_owned (GPerlBrigade * brigade, GBytes * bytes)
+{
+	gsize size = g_bytes_get_size (bytes);
+	if (!size) {
+		g_bytes_unref (bytes);
+		return;
+	}
+	g_queue_push_tail (&brigade->buckets, bytes);
+	brigade->length += size;
+}
+
+void
+perl_brigade_append_bytes (GPerlBrigade * brigade, GBytes * bytes)
+{
+	g_return_if_fail (brigade != NULL && bytes != NULL);
+	append_owned (brigade, g_bytes_ref (bytes));
+}
+
+void
+perl_brigade_append_data (GPerlBrigade * brigade, gconstpointer data, gsize size)
+{
+	g_return_if_fail (brigade != NULL);
+	append_owned (brigade, g_bytes_new (data, size));
+}
+
+void
+perl_brigade_append_static (GPerlBrigade * brigade, gconstpointer data, gsize size)
+{
+	g_return_if_fail (brigade != NULL);
+	append_owned (brigade, g_bytes_new_static (data, size));
+}
+
+gboolean
+perl_brigade_append_file (GPerlBrigade * brigade,
+                           const char   * filename,
+                           GError      ** error)
+{
+	GMappedFile * file;
+
+	g_return_val_if_fail (brigade != NULL && filename != NULL, FALSE);
+
+	file = g_mapped_file_new (filename, FALSE, error);
+	if (!file)
+		return FALSE;
+	/* the bytes keep the mapping alive for as long as any slice of it is
+	 * still travelling through a pipeline. */
+	append_owned (brigade, g_mapped_file_get_bytes (file));
+	g_mapped_file_unref (file);
+	return TRUE;
+}
+
+gsize
+perl_brigade_get_length (const GPerlBrigade * brigade)
+{
+	g_return_val_if_fail (brigade != NULL, 0);
+	return brigade->length;
+}
+
+guint
+perl_brigade_get_n_buckets (const GPerlBrigade * brigade)
+{
+	g_return_val_if_fail (brigade != NULL, 0);
+	return brigade->buckets.length;
+}
+
+gboolean
+perl_brigade_is_empty (const GPerlBrigade * brigade)
+{
+	g_return_val_if_fail (brigade != NULL, TRUE);
+	return brigade->length == 0;
+}
+
+gboolean
+perl_brigade_get_eos (const GPerlBrigade * brigade)
+{
+	g_return_val_if_fail (brigade != NULL, FALSE);
+	return brigade->eos;
+}
+
+void
+perl_brigade_set_eos (GPerlBrigade * brigade, gboolean eos)
+{
+	g_return_if_fail (brigade != NULL);
+	brigade->eos = eos;
+}
+
+GBytes *
+perl_brigade_pop (GPerlBrigade * brigade)
+{
+	GBytes * bytes;
+
+	g_return_val_if_fail (brigade != NULL, NULL);
+
+	bytes = g_queue_pop_head (&brigade->buckets);
+	if (bytes)
+		brigade->length -= g_bytes_get_size (bytes);
+	return bytes;
+}
+
+void
+perl_brigade_move (GPerlBrigade * dest, GPerlBrigade * src)
+{
+	g_return_if_fail (dest != NULL && src != NULL);
+
+	/* splice the lists instead of moving buckets one by one. */
+	if (src->buckets.head) {
+		if (dest->buckets.tail) {
+			dest->buckets.tail->next = src->buckets.head;
+			src->buckets.head->prev = dest->buckets.tail;
+			dest->buckets.tail = src->buckets.tail;
+			dest->buckets.length += src->buckets.length;
+		} else {
+			dest->buckets = src->buckets;
+		}
+		g_queue_init (&src->buckets);
+	}
+	dest->length += src->length;
+	dest->eos = dest->eos || src->eos;
+	src->length = 0;
+	src->eos = FALSE;
+}
+
+GPerlBrigade *
+perl_brigade_split (GPerlBrigade * brigade, gsize offset)
+{
+	GPerlBrigade * tail;
+	GList * l;
+	gsize seen = 0;
+
+	g_return_val_if_fail (brigade != NULL, NULL);
+
+	tail = perl_brigade_new ();
+	if (offset >= brigade->length) {
+		tail->eos = brigade->eos;
+		brigade->eos = FALSE;
+		return tail;
+	}
+
+	for (l = brigade->buckets.head ; l ; l = l->next) {
+		gsize size = g_bytes_get_size (l->data);
+		if (seen + size > offset)
+			break;
+		seen += size;
+	}
+
+	/* l is the bucket holding byte offset; share it if it straddles. */
+	if (offset > seen) {
+		GBytes * bytes = l->data;
+		gsize size = g_bytes_get_size (bytes);
+		gsize head = offset - seen;
+
+		g_queue_push_tail (&tail->buckets,
+		                   g_bytes_new_from_bytes (bytes, head, size - head));
+		tail->length = size - head;
+		l->data = g_bytes_new_from_bytes (bytes, 0, head);
+		g_bytes_unref (bytes);
+		l = l->next;
+	}
+
+	while (l) {
+		GList * next = l->next;
+		GBytes * bytes = l->data;
+		gsize size = g_bytes_get_size (bytes);
+
+		g_queue_delete_link (&brigade->buckets, l);
+		g_queue_push_tail (&tail->buckets, bytes);
+		tail->length += size;
+		l = next;
+	}
+
+	brigade->length = offset;
+	tail->eos = brigade->eos;
+	brigade->eos = FALSE;
+	return tail;
+}
+
+guint
+perl_brigade_get_vectors (const GPerlBrigade * brigade,
+                           GPerlBucketVector  * vectors,
+                           guint                n_vectors)
+{
+	GList * l;
+	guint n = 0;
+
+	g_return_val_if_fail (brigade != NULL, 0);
+
+	for (l = brigade->buckets.head ; l && n < n_vectors ; l = l->next, n++)
+		vectors[n].data = g_bytes_get_data (l->data, &vectors[n].size);
+	return n;
+}
+
+GBytes *
+perl_brigade_flatten (const GPerlBrigade * brigade)
+{
+	GList * l;
+	guint8 * data, * p;
+
+	g_return_val_if_fail (brigade != NULL, NULL);
+
+	if (brigade->buckets.length == 0)
+		return g_bytes_new (NULL, 0);
+	if (brigade->buckets.length == 1)
+		return g_bytes_ref (brigade->buckets.head->data);
+
+	p = data = g_malloc (brigade->length);
+	for (l = brigade->buckets.head ; l ; l = l->next) {
+		gsize size;
+		gconstpointer chunk = g_bytes_get_data (l->data, &size);
+		memcpy (p, chunk, size);
+		p += size;
+	}
+	return g_bytes_new_take (data, brigade->length);
+}
+
+/*
+ * --- bounded queues between threaded stages ---------------------------------
+ */
+
+typedef struct {
+	GMutex   lock;
+	GCond    not_empty;
+	GCond    not_full;
+	GQueue   items;
+	guint    capacity;
+	gboolean closed;
+} Channel;
+
+static Channel *
+channel_new (guint capacity)
+{
+	Channel * ch = g_slice_new0 (Channel);
+	g_mutex_init (&ch->lock);
+	g_cond_init (&ch->not_empty);
+	g_cond_init (&ch->not_full);
+	g_queue_init (&ch->items);
+	ch->capacity = capacity;
+	return ch;
+}
+
+static void
+channel_free (Channel * ch)
+{
+	g_queue_clear_full (&ch->items, (GDestroyNotify) perl_brigade_free);
+	g_mutex_clear (&ch->lock);
+	g_cond_clear (&ch->not_empty);
+	g_cond_clear (&ch->not_full);
+	g_slice_free (Channel, ch);
+}
+
+/* blocks while the channel is full; this is the backpressure. */
+static void
+channel_push (Channel * ch, GPerlBrigade * brigade)
+{
+	g_mutex_lock (&ch->lock);
+	while (ch->items.length >= ch->capacity)
+		g_cond_wait (&ch->not_full, &ch->lock);
+	g_queue_push_tail (&ch->items, brigade);
+	g_cond_signal (&ch->not_empty);
+	g_mutex_unlock (&ch->lock);
+}
+
+/* NULL once the channel is closed and drained. */
+static GPerlBrigade *
+channel_pop (Channel * ch)
+{
+	GPerlBrigade * brigade;
+
+	g_mutex_lock (&ch->lock);
+	while (!ch->items.length && !ch->closed)
+		g_cond_wait (&ch->not_empty, &ch->lock);
+	brigade = g_queue_pop_head (&ch->items);
+	if (brigade)
+		g_cond_signal (&ch->not_full);
+	g_mutex_unlock (&ch->lock);
+	return brigade;
+}
+
+static void
+channel_close (Channel * ch)
+{
+	g_mutex_lock (&ch->lock);
+	ch->closed = TRUE;
+	g_cond_broadcast (&ch->not_empty);
+	g_mutex_unlock (&ch->lock);
+}
+
+/*
+ * --- stages and pipelines ---------------------------------------------------
+ */
+
+typedef struct {
+	GPerlFilterPipeline    * pipeline;
+	guint                    index;
+	const GPerlFilterClass * klass;
+	gpointer                 user_data;
+	GDestroyNotify           destroy;
+	GPerlBrigade           * pending;	/* input the stage left unconsumed */
+	Channel                * input;	/* threaded mode only */
+	GThread                * thread;
+} Stage;
+
+struct _GPerlFilterPipeline {
+	GPtrArray         * stages;
+	GPerlFilterSinkFunc sink;
+	gpointer            sink_data;
+	guint               queue_depth;
+	gboolean            started;
+	gboolean            finished;
+	GMutex              error_lock;
+	GError            * error;
+	volatile gint       failed;
+};
+
+static void
+pipeline_fail (GPerlFilterPipeline * pipeline, const Stage * stage, GError * error)
+{
+	g_mutex_lock (&pipeline->error_lock);
+	if (!pipeline->error) {
+		if (!error)
+			error = g_error_new (G_FILE_ERROR, G_FILE_ERROR_FAILED,
+			                     "filter stage '%s' failed",
+			                     stage->klass->name ? stage->klass->name : "?");
+		pipeline->error = error;
+		error = NULL;
+	}
+	g_mutex_unlock (&pipeline->error_lock);
+	if (error)
+		g_error_free (error);
+	g_atomic_int_set (&pipeline->failed, TRUE);
+}
+
+static gboolean
+report_failure (GPerlFilterPipeline * pipeline, GError ** error)
+{
+	if (!g_atomic_int_get (&pipeline->failed))
+		return TRUE;
+	g_mutex_lock (&pipeline->error_lock);
+	if (error && pipeline->error)
+		*error = g_error_copy (pipeline->error);
+	g_mutex_unlock (&pipeline->error_lock);
+	return FALSE;
+}
+
+/* run one brigade through one stage; takes ownership of in.  returns the
+ * stage's output, or NULL on failure. */
+static GPerlBrigade *
+stage_process (Stage * stage, GPerlBrigade * in)
+{
+	GPerlBrigade * out = perl_brigade_new ();
+	GError * error = NULL;
+
+	perl_brigade_move (stage->pending, in);
+	perl_brigade_free (in);
+	if (!stage->klass->process (stage->user_data, stage->pending, out, &error)) {
+		pipeline_fail (stage->pipeline, stage, error);
+		perl_brigade_free (out);
+		return NULL;
+	}
+	return out;
+}
+
+static GPerlBrigade *
+stage_finalize (Stage * stage)
+{
+	GPerlBrigade * out = perl_brigade_new ();
+	GError * error = NULL;
+
+	if (!stage->klass->finalize) {
+		perl_brigade_move (out, stage->pending);
+	} else if (!stage->klass->finalize (stage->user_data, stage->pending,
+	                                    out, &error)) {
+		pipeline_fail (stage->pipeline, stage, error);
+		perl_brigade_free (out);
+		return NULL;
+	}
+	out->eos = FALSE;
+	return out;
+}
+
+static gboolean
+stage_init (Stage * stage)
+{
+	GError * error = NULL;
+	if (!stage->klass->init || stage->klass->init (stage->user_data, &error))
+		return TRUE;
+	pipeline_fail (stage->pipeline, stage, error);
+	return FALSE;
+}
+
+/* hand the output of stage index - 1 onwards.  in synchronous mode this
+ * runs the remaining stages right here. */
+static void
+forward (GPerlFilterPipeline * pipeline, guint index, GPerlBrigade * brigade)
+{
+	guint n = pipeline->stages->len;
+
+	if (!pipeline->queue_depth) {
+		for ( ; index < n && brigade ; index++) {
+			if (perl_brigade_is_empty (brigade) && !brigade->eos)
+				break;
+			brigade = stage_process (g_ptr_array_index (pipeline->stages, index),
+			                         brigade);
+		}
+	}
+
+	if (!brigade)
+		return;
+	if (perl_brigade_is_empty (brigade) && !brigade->eos)
+		perl_brigade_free (brigade);
+	else if (index >= n)
+		pipeline->sink (brigade, pipeline->sink_data);
+	else
+		channel_push (((Stage *) g_ptr_array_index (pipeline->stages, index))->input,
+		              brigade);
+}
+
+static void
+send_eos (GPerlFilterPipeline * pipeline)
+{
+	GPerlBrigade * eos = perl_brigade_new ();
+	eos->eos = TRUE;
+	pipeline->sink (eos, pipeline->sink_data);
+}
+
+static void
+finish_stage (Stage * stage)
+{
+	GPerlFilterPipeline * pipeline = stage->pipeline;
+	GPerlBrigade * out = NULL;
+
+	if (!g_atomic_int_get (&pipeline->failed))
+		out = stage_finalize (stage);
+	if (stage->index + 1 < pipeline->stages->len) {
+		if (out)
+			forward (pipeline, stage->index + 1, out);
+		return;
+	}
+	/* the last stage ends the stream for the sink, failed or not. */
+	if (!out)
+		out = perl_brigade_new ();
+	out->eos = TRUE;
+	forward (pipeline, stage->index + 1, out);
+}
+
+static gpointer
+stage_thread (gpointer data)
+{
+	Stage * stage = data;
+	GPerlFilterPipeline * pipeline = stage->pipeline;
+	GPerlBrigade * brigade;
+
+	while ((brigade = channel_pop (stage->input))) {
+		/* after a failure keep draining, so nobody upstream stays
+		 * blocked on a full queue. */
+		if (g_atomic_int_get (&pipeline->failed)) {
+			perl_brigade_free (brigade);
+			continue;
+		}
+		brigade = stage_process (stage, brigade);
+		if (brigade)
+			forward (pipeline, stage->index + 1, brigade);
+	}
+
+	finish_stage (stage);
+	if (stage->index + 1 < pipeline->stages->len)
+		channel_close (((Stage *) g_ptr_array_index (pipeline->stages,
+		                                             stage->index + 1))->input);
+	return NULL;
+}
+
+static void
+pipeline_start (GPerlFilterPipeline * pipeline)
+{
+	guint i;
+
+	pipeline->started = TRUE;
+	for (i = 0 ; i < pipeline->stages->len ; i++)
+		if (!stage_init (g_ptr_array_index (pipeline->stages, i)))
+			return;
+
+	if (!pipeline->queue_depth)
+		return;
+	for (i = 0 ; i < pipeline->stages->len ; i++) {
+		Stage * stage = g_ptr_array_index (pipeline->stages, i);
+		stage->input = channel_new (pipeline->queue_depth);
+	}
+	for (i = 0 ; i < pipeline->stages->len ; i++) {
+		Stage * stage = g_ptr_array_index (pipeline->stages, i);
+		stage->thread = g_thread_new (stage->klass->name
+		                              ? stage->klass->name : "filter",
+		                              stage_thread, stage);
+	}
+}
+
+GPerlFilterPipeline *
+perl_filter_pipeline_new (GPerlFilterSinkFunc sink,
+                           gpointer            sink_data,
+                           guint               queue_depth)
+{
+	GPerlFilterPipeline * pipeline;
+
+	g_return_val_if_fail (sink != NULL, NULL);
+
+	pipeline = g_new0 (GPerlFilterPipeline, 1);
+	pipeline->stages = g_ptr_array_new ();
+	pipeline->sink = sink;
+	pipeline->sink_data = sink_data;
+	pipeline->queue_depth = queue_depth;
+	g_mutex_init (&pipeline->error_lock);
+	return pipeline;
+}
+
+void
+perl_filter_pipeline_add (GPerlFilterPipeline    * pipeline,
+                           const GPerlFilterClass * klass,
+                           gpointer                 user_data,
+                           GDestroyNotify           destroy)
+{
+	Stage * stage;
+
+	g_return_if_fail (pipeline != NULL);
+	g_return_if_fail (klass != NULL && klass->process != NULL);
+	g_return_if_fail (!pipeline->started);
+
+	stage = g_new0 (Stage, 1);
+	stage->pipeline = pipeline;
+	stage->index = pipeline->stages->len;
+	stage->klass = klass;
+	stage->user_data = user_data;
+	stage->destroy = destroy;
+	stage->pending = perl_brigade_new ();
+	g_ptr_array_add (pipeline->stages, stage);
+}
+
+gboolean
+perl_filter_pipeline_push (GPerlFilterPipeline * pipeline,
+                            GPerlBrigade        * brigade,
+                            GError             ** error)
+{
+	g_return_val_if_fail (pipeline != NULL, FALSE);
+	g_return_val_if_fail (brigade != NULL, FALSE);
+	g_return_val_if_fail (!pipeline->finished, FALSE);
+
+	if (!pipeline->started)
+		pipeline_start (pipeline);
+	if (g_atomic_int_get (&pipeline->failed)) {
+		perl_brigade_free (brigade);
+		return report_failure (pipeline, error);
+	}
+
+	brigade->eos = FALSE;
+	forward (pipeline, 0, brigade);
+	return report_failure (pipeline, error);
+}
+
+gboolean
+perl_filter_pipeline_finish (GPerlFilterPipeline * pipeline,
+                              GError             ** error)
+{
+	guint i, n;
+
+	g_return_val_if_fail (pipeline != NULL, FALSE);
+
+	if (pipeline->finished)
+		return report_failure (pipeline, error);
+	if (!pipeline->started)
+		pipeline_start (pipeline);
+	pipeline->finished = TRUE;
+	n = pipeline->stages->len;
+
+	if (n == 0) {
+		send_eos (pipeline);
+
+	} else if (pipeline->queue_depth) {
+		Stage * first = g_ptr_array_index (pipeline->stages, 0);
+		/* a failed init never started the threads, so nothing else
+		 * will tell the sink. */
+		if (first->thread) {
+			channel_close (first->input);
+			for (i = 0 ; i < n ; i++)
+				g_thread_join (((Stage *) g_ptr_array_index (pipeline->stages, i))->thread);
+		} else {
+			send_eos (pipeline);
+		}
+
+	} else {
+		/* each finalize may still produce data for the stages after
+		 * it, so flush them strictly in order. */
+		for (i = 0 ; i < n ; i++)
+			finish_stage (g_ptr_array_index (pipeline->stages, i));
+	}
+
+	return report_failure (pipeline, error);
+}
+
+void
+perl_filter_pipeline_free (GPerlFilterPipeline * pipeline)
+{
+	guint i;
+
+	if (!pipeline)
+		return;
+	if (pipeline->started && !pipeline->finished)
+		perl_filter_pipeline_finish (pipeline, NULL);
+
+	for (i = 0 ; i < pipeline->stages->len ; i++) {
+		Stage * stage = g_ptr_array_index (pipeline->stages, i);
+		if (stage->destroy)
+			stage->destroy (stage->user_data);
+		if (stage->input)
+			channel_free (stage->input);
+		perl_brigade_free (stage->pending);
+		g_free (stage);
+	}
+	g_ptr_array_free (pipeline->stages, TRUE);
+	g_mutex_clear (&pipeline->error_lock);
+	g_clear_error (&pipeline->error);
+	g_free (pipeline);
+}
@@ -0,0 +1,401 @@
+/*
+ * array-level 64 bit integer conversions; see gperl_int64.h.
+ */
+
+#include <string.h>
+
+#include "gperl_int64.h"
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+# define PERL_INT64_HAVE_X86 1
+# include <immintrin.h>
+# define PERL_INT64_AVX2	__attribute__ ((target ("avx2")))
+#endif
+
+/*
+ * --- instruction set selection ----------------------------------------------
+ */
+
+#ifdef PERL_INT64_HAVE_X86
+/* 0 means "not checked yet", 1 no, 2 yes. */
+static volatile gint have_avx2 = 0;
+
+static gboolean
+use_avx2 (void)
+{
+	gint avx2 = g_atomic_int_get (&have_avx2);
+	if (G_UNLIKELY (avx2 == 0)) {
+		__builtin_cpu_init ();
+		avx2 = __builtin_cpu_supports ("avx2") ? 2 : 1;
+		g_atomic_int_set (&have_avx2, avx2);
+	}
+	return avx2 == 2;
+}
+#endif
+
+/*
+ * --- byte swapping ----------------------------------------------------------
+ */
+
+static void
+swap_copy_scalar (const guchar * src, guchar * dest, gsize start, gsize n)
+{
+	gsize i;
+	for (i = start ; i < n ; i++) {
+		guint64 v;
+		memcpy (&v, src + 8 * i, 8);
+		v = GUINT64_SWAP_LE_BE (v);
+		memcpy (dest + 8 * i, &v, 8);
+	}
+}
+
+#ifdef PERL_INT64_HAVE_X86
+PERL_INT64_AVX2 static gsize
+swap_copy_avx2 (const guchar * src, guchar * dest, gsize n)
+{
+	/* reverse the bytes within each 64 bit lane */
+	const __m256i mask = _mm256_setr_epi8 (7, 6, 5, 4, 3, 2, 1, 0,
+	                                       15, 14, 13, 12, 11, 10, 9, 8,
+	                                       7, 6, 5, 4, 3, 2, 1, 0,
+	                                       15, 14, 13, 12, 11, 10, 9, 8);
+	gsize i;
+
+	for (i = 0 ; i + 4 <= n ; i += 4) {
+		__m256i v = _mm256_loadu_si256 ((const __m256i *) (src + 8 * i));
+		_mm256_storeu_si256 ((__m256i *) (dest + 8 * i),
+		                     _mm256_shuffle_epi8 (v, mask));
+	}
+	return i;
+}
+#endif
+
+/* src and dest may be the same buffer, but must not otherwise overlap. */
+static void
+swap_copy (const guchar * src, guchar * dest, gsize n)
+{
+	gsize done = 0;
+#ifdef PERL_INT64_HAVE_X86
+	if (use_avx2 ())
+		done = swap_copy_avx2 (src, dest, n);
+#endif
+	swap_copy_scalar (src, dest, done, n);
+}
+
+void
+perl_int64_array_swap (guint64 * values, gsize n_values)
+{
+	swap_copy ((const guchar *) values, (guchar *) values, n_values);
+}
+
+static gboolean
+wire_is_host_order (gboolean big_endian)
+{
+	return big_endian ? G_BYTE_ORDER == G_BIG_ENDIAN
+	                  : G_BYTE_ORDER == G_LITTLE_ENDIAN;
+}
+
+void
+perl_int64_array_unpack (const guchar  * data,
+                          gsize           n_values,
+                          gboolean        big_endian,
+                          guint64       * values)
+{
+	if (wire_is_host_order (big_endian))
+		memcpy (values, data, 8 * n_values);
+	else
+		swap_copy (data, (guchar *) values, n_values);
+}
+
+void
+perl_int64_array_pack (const guint64 * values,
+                        gsize           n_values,
+                        gboolean        big_endian,
+                        guchar        * data)
+{
+	if (wire_is_host_order (big_endian))
+		memcpy (data, values, 8 * n_values);
+	else
+		swap_copy ((const guchar *) values, data, n_values);
+}
+
+/*
+ * --- range checks -----------------------------------------------------------
+ */
+
+static gsize
+check_range_scalar (const gint64 * values, gsize start, gsize n,
+                    gint64 min, gint64 max)
+{
+	gsize i;
+	for (i = start ; i < n ; i++)
+		if (values[i] < min || values[i] > max)
+			break;
+	return i;
+}
+
+#ifdef PERL_INT64_HAVE_X86
+/* returns the start of the first block of four holding an offender, or
+ * the end of the last whole block. */
+PERL_INT64_AVX2 static gsize
+check_range_avx2 (const gint64 * values, gsize n, gint64 min, gint64 max)
+{
+	const __m256i vmin = _mm256_set1_epi64x (min);
+	const __m256i vmax = _mm256_set1_epi64x (max);
+	gsize i;
+
+	for (i = 0 ; i + 4 <= n ; i += 4) {
+		__m256i v = _mm256_loadu_si256 ((const __m256i *) (values + i));
+		__m256i bad = _mm256_or_si256 (_mm256_cmpgt_epi64 (v, vmax),
+		                               _mm256_cmpgt_epi64 (vmin, v));
+		if (!_mm256_testz_si256 (bad, bad))
+			break;
+	}
+	return i;
+}
+
+/* same, for unsigned values: flipping the sign bit maps unsigned order
+ * onto signed order. */
+PERL_INT64_AVX2 static gsize
+check_urange_avx2 (const guint64 * values, gsize n, guint64 max)
+{
+	const __m256i bias = _mm256_set1_epi64x (G_MININT64);
+	const __m256i vmax = _mm256_xor_si256 (_mm256_set1_epi64x ((gint64) max),
+	                                       bias);
+	gsize i;
+
+	for (i = 0 ; i + 4 <= n ; i += 4) {
+		__m256i v = _mm256_loadu_si256 ((const __m256i *) (values + i));
+		__m256i bad = _mm256_cmpgt_epi64 (_mm256_xor_si256 (v, bias),
+		                                  vmax);
+		if (!_mm256_testz_si256 (bad, bad))
+			break;
+	}
+	return i;
+}
+#endif
+
+gsize
+perl_int64_array_check_range (const gint64 * values,
+                               gsize          n_values,
+                               gint64         min,
+                               gint64         max)
+{
+	gsize done = 0;
+#ifdef PERL_INT64_HAVE_X86
+	if (use_avx2 ())
+		done = check_range_avx2 (values, n_values, min, max);
+#endif
+	return check_range_scalar (values, done, n_values, min, max);
+}
+
+gsize
+perl_uint64_array_check_range (const guint64 * values,
+                                gsize           n_values,
+                                guint64         max)
+{
+	gsize i = 0;
+
+	if (max == G_MAXUINT64)
+		return n_values;
+#ifdef PERL_INT64_HAVE_X86
+	if (use_avx2 ())
+		i = check_urange_avx2 (values, n_values, max);
+#endif
+	for ( ; i < n_values ; i++)
+		if (values[i] > max)
+			break;
+	return i;
+}
+
+/*
+ * --- perl arrays ------------------------------------------------------------
+ */
+
+static gint64
+sv_to_int64 (pTHX_ SV * sv)
+{
+#if IVSIZE >= 8
+	IV iv;
+	if (SvIOK (sv) && !SvIsUV (sv) && !SvGMAGICAL (sv))
+		return SvIVX (sv);
+	iv = SvIV (sv);
+	/* SvIV wraps unsigned values past IV_MAX around to negative ones */
+	if (SvIsUV (sv) && SvUVX (sv) > (UV) IV_MAX)
+		croak ("value %" UVuf " is too large for a signed 64 bit "
+		       "integer", SvUVX (sv));
+	return iv;
+#else
+	return SvGInt64 (sv);
+#endif
+}
+
+static guint64
+sv_to_uint64 (pTHX_ SV * sv)
+{
+#if IVSIZE >= 8
+	IV iv = SvIV (sv);
+	if (SvIsUV (sv))
+		return SvUVX (sv);
+	if (iv < 0)
+		croak ("negative value %" IVdf " where an unsigned 64 bit "
+		       "integer was expected", iv);
+	return iv;
+#else
+	if (SvIOK (sv) && !SvIsUV (sv) && SvIVX (sv) < 0)
+		croak ("negative value %" IVdf " where an unsigned 64 bit "
+		       "integer was expected", SvIVX (sv));
+	return SvGUInt64 (sv);
+#endif
+}
+
+void
+perl_int64_array_from_av (AV * av, gint64 * values, gsize n_values)
+{
+	dTHX;
+	gsize i;
+	for (i = 0 ; i < n_values ; i++) {
+		SV ** svp = av_fetch (av, i, FALSE);
+		values[i] = (svp && *svp) ? sv_to_int64 (aTHX_ *svp) : 0;
+	}
+}
+
+void
+perl_uint64_array_from_av (AV * av, guint64 * values, gsize n_values)
+{
+	dTHX;
+	gsize i;
+	for (i = 0 ; i < n_values ; i++) {
+		SV ** svp = av_fetch (av, i, FALSE);
+		values[i] = (svp && *svp) ? sv_to_uint64 (aTHX_ *svp) : 0;
+	}
+}
+
+AV *
+perl_int64_array_to_av (const gint64 * values, gsize n_values)
+{
+	dTHX;
+	AV * av = newAV ();
+	gsize i;
+
+	if (n_values)
+		av_extend (av, n_values - 1);
+#if IVSIZE >= 8
+	for (i = 0 ; i < n_values ; i++)
+		av_store (av, i, newSViv (values[i]));
+#else
+	i = 0;
+	while (i < n_values) {
+		gsize end = i + perl_int64_array_check_range (values + i,
+		                                               n_values - i,
+		                                               IV_MIN, IV_MAX);
+		for ( ; i < end ; i++)
+			av_store (av, i, newSViv ((IV) values[i]));
+		if (i < n_values) {
+			av_store (av, i, newSVGInt64 (values[i]));
+			i++;
+		}
+	}
+#endif
+	return av;
+}
+
+AV *
+perl_uint64_array_to_av (const guint64 * values, gsize n_values)
+{
+	dTHX;
+	AV * av = newAV ();
+	gsize i;
+
+	if (n_values)
+		av_extend (av, n_values - 1);
+#if IVSIZE >= 8
+	for (i = 0 ; i < n_values ; i++)
+		av_store (av, i, newSVuv (values[i]));
+#else
+	i = 0;
+	while (i < n_values) {
+		gsize end = i + perl_uint64_array_check_range (values + i,
+		                                                n_values - i,
+		                                                UV_MAX);
+		for ( ; i < end ; i++)
+			av_store (av, i, newSVuv ((UV) values[i]));
+		if (i < n_values) {
+			av_store (av, i, newSIGURGInt64 (values[i]));
+			i++;
+		}
+	}
+#endif
+	return av;
+}
+
+/*
+ * --- GValue and GVariant ----------------------------------------------------
+ */
+
+void
+perl_int64_array_to_values (const gint64 * values,
+                             gsize          n_values,
+                             gboolean       is_unsigned,
+                             GValue       * gvalues)
+{
+	gsize i;
+
+	if (is_unsigned)
+		for (i = 0 ; i < n_values ; i++) {
+			g_value_init (&gvalues[i], G_TYPE_UINT64);
+			g_value_set_uint64 (&gvalues[i], (guint64) values[i]);
+		}
+	else
+		for (i = 0 ; i < n_values ; i++) {
+			g_value_init (&gvalues[i], G_TYPE_INT64);
+			g_value_set_int64 (&gvalues[i], values[i]);
+		}
+}
+
+gboolean
+perl_int64_array_from_values (const GValue * gvalues,
+                               gsize          n_values,
+                               gint64       * values)
+{
+	gsize i;
+
+	for (i = 0 ; i < n_values ; i++) {
+		if (G_VALUE_HOLDS_INT64 (&gvalues[i]))
+			values[i] = g_value_get_int64 (&gvalues[i]);
+		else if (G_VALUE_HOLDS_UINT64 (&gvalues[i]))
+			values[i] = (gint64) g_value_get_uint64 (&gvalues[i]);
+		else
+			return FALSE;
+	}
+	return TRUE;
+}
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+
+GVariant *
+perl_int64_array_to_variant (const gint64 * values,
+                              gsize          n_values,
+                              gboolean       is_unsigned)
+{
+	return g_variant_new_fixed_array (is_unsigned
+	                                  ? G_VARIANT_TYPE_UINT64
+	                                  : G_VARIANT_TYPE_INT64,
+	                                  values, n_values, sizeof (gint64));
+}
+
+#endif /* 2.32.0 */
+
+#if GLIB_CHECK_VERSION (2, 24, 0)
+
+const gint64 *
+perl_int64_array_from_variant (GVariant * variant, gsize * n_values)
+{
+	g_return_val_if_fail (variant != NULL, NULL);
+
+	if (!g_variant_is_of_type (variant, G_VARIANT_TYPE ("ax")) &&
+	    !g_variant_is_of_type (variant, G_VARIANT_TYPE ("at")))
+		return NULL;
+	return g_variant_get_fixed_array (variant, n_values, sizeof (gint64));
+}
+
+#endif /* 2.24.0 */
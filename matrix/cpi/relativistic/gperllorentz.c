@@ -0,0 +1,507 @@
+/*
+ * batched Lorentz transform and velocity addition kernels; see
+ * gperl_lorentz.h for the interface.
+ *
+ * the rule that keeps the three paths bit-identical: every kernel is written
+ * once as a scalar function and the vector versions repeat its expressions
+ * operation for operation, lane by lane.  only +, -, *, / and sqrt are used,
+ * all of which IEEE 754 rounds correctly in both scalar and packed form, and
+ * contraction into fused multiply-adds is switched off below because a fused
+ * a*b+c rounds once where the scalar code rounds twice.
+ */
+
+#if defined (__clang__)
+# pragma STDC FP_CONTRACT OFF
+#elif defined (__GNUC__)
+# pragma GCC optimize ("fp-contract=off")
+#endif
+
+#include <math.h>
+
+#include "gperl_lorentz.h"
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+# define PERL_LORENTZ_HAVE_X86 1
+# include <immintrin.h>
+# define PERL_LORENTZ_AVX2	__attribute__ ((target ("avx2")))
+# define PERL_LORENTZ_AVX512	__attribute__ ((target ("avx512f")))
+#endif
+
+/*
+ * --- instruction set selection ----------------------------------------------
+ */
+
+static GPerlLorentzIsa
+best_isa (void)
+{
+#ifdef PERL_LORENTZ_HAVE_X86
+	__builtin_cpu_init ();
+	if (__builtin_cpu_supports ("avx512f"))
+		return PERL_LORENTZ_ISA_AVX512;
+	if (__builtin_cpu_supports ("avx2"))
+		return PERL_LORENTZ_ISA_AVX2;
+#endif
+	return PERL_LORENTZ_ISA_SCALAR;
+}
+
+/* 0 means "not chosen yet"; otherwise isa + 1. */
+static volatile gint current_isa = 0;
+
+GPerlLorentzIsa
+perl_lorentz_get_isa (void)
+{
+	gint isa = g_atomic_int_get (&current_isa);
+	if (G_UNLIKELY (isa == 0)) {
+		isa = best_isa () + 1;
+		g_atomic_int_set (&current_isa, isa);
+	}
+	return (GPerlLorentzIsa) (isa - 1);
+}
+
+void
+perl_lorentz_set_isa (GPerlLorentzIsa isa)
+{
+	GPerlLorentzIsa best = best_isa ();
+	if (isa > best)
+		isa = best;
+	g_atomic_int_set (&current_isa, isa + 1);
+}
+
+/*
+ * --- scalar reference kernels -----------------------------------------------
+ *
+ * these also finish off whatever tail the vector loops leave over.
+ */
+
+typedef struct {
+	gdouble bx, by, bz;
+	gdouble gamma;
+	gdouble k;		/* (gamma - 1) / beta^2 */
+} BoostParams;
+
+static void
+boost_params_init (BoostParams * p, gdouble bx, gdouble by, gdouble bz)
+{
+	gdouble b2 = bx * bx + by * by + bz * bz;
+
+	p->bx = bx;
+	p->by = by;
+	p->bz = bz;
+	p->gamma = 1.0 / sqrt (1.0 - b2);
+	p->k = b2 > 0.0 ? (p->gamma - 1.0) / b2 : 0.0;
+}
+
+static void
+boost_scalar (const BoostParams * p,
+              gdouble * t, gdouble * x, gdouble * y, gdouble * z,
+              gsize start, gsize n)
+{
+	gsize i;
+	for (i = start ; i < n ; i++) {
+		gdouble bd = p->bx * x[i] + p->by * y[i] + p->bz * z[i];
+		gdouble s = p->k * bd - p->gamma * t[i];
+		t[i] = p->gamma * (t[i] - bd);
+		x[i] = x[i] + s * p->bx;
+		y[i] = y[i] + s * p->by;
+		z[i] = z[i] + s * p->bz;
+	}
+}
+
+static void
+velocity_add_scalar (const gdouble * u, const gdouble * v, gdouble * w,
+                     gsize start, gsize n)
+{
+	gsize i;
+	for (i = start ; i < n ; i++)
+		w[i] = (u[i] + v[i]) / (1.0 + u[i] * v[i]);
+}
+
+typedef struct {
+	gdouble vx, vy, vz;
+	gdouble inv_gamma;	/* sqrt (1 - v^2) */
+	gdouble kk;		/* gamma / (gamma + 1) */
+} AddParams;
+
+static void
+add_params_init (AddParams * p, gdouble vx, gdouble vy, gdouble vz)
+{
+	gdouble v2 = vx * vx + vy * vy + vz * vz;
+	gdouble gamma;
+
+	p->vx = vx;
+	p->vy = vy;
+	p->vz = vz;
+	p->inv_gamma = sqrt (1.0 - v2);
+	gamma = 1.0 / p->inv_gamma;
+	p->kk = gamma / (gamma + 1.0);
+}
+
+static void
+velocity_add_3_scalar (const AddParams * p,
+                       gdouble * ux, gdouble * uy, gdouble * uz,
+                       gsize start, gsize n)
+{
+	gsize i;
+	for (i = start ; i < n ; i++) {
+		gdouble vu = p->vx * ux[i] + p->vy * uy[i] + p->vz * uz[i];
+		gdouble d = 1.0 + vu;
+		gdouble f = 1.0 + p->kk * vu;
+		ux[i] = (ux[i] * p->inv_gamma + p->vx * f) / d;
+		uy[i] = (uy[i] * p->inv_gamma + p->vy * f) / d;
+		uz[i] = (uz[i] * p->inv_gamma + p->vz * f) / d;
+	}
+}
+
+static void
+gamma_scalar (const gdouble * beta, gdouble * gamma, gsize start, gsize n)
+{
+	gsize i;
+	for (i = start ; i < n ; i++)
+		gamma[i] = 1.0 / sqrt ((1.0 - beta[i]) * (1.0 + beta[i]));
+}
+
+/* atanh (b) = log1p (2b / (1 - b)) / 2; this part computes the argument. */
+static void
+rapidity_arg_scalar (const gdouble * beta, gdouble * out, gsize start, gsize n)
+{
+	gsize i;
+	for (i = start ; i < n ; i++)
+		out[i] = (beta[i] + beta[i]) / (1.0 - beta[i]);
+}
+
+/*
+ * --- AVX2 -------------------------------------------------------------------
+ */
+#ifdef PERL_LORENTZ_HAVE_X86
+
+PERL_LORENTZ_AVX2 static gsize
+boost_avx2 (const BoostParams * p,
+            gdouble * t, gdouble * x, gdouble * y, gdouble * z, gsize n)
+{
+	__m256d bx = _mm256_set1_pd (p->bx);
+	__m256d by = _mm256_set1_pd (p->by);
+	__m256d bz = _mm256_set1_pd (p->bz);
+	__m256d g = _mm256_set1_pd (p->gamma);
+	__m256d k = _mm256_set1_pd (p->k);
+	gsize i;
+
+	for (i = 0 ; i + 4 <= n ; i += 4) {
+		__m256d vt = _mm256_loadu_pd (t + i);
+		__m256d vx = _mm256_loadu_pd (x + i);
+		__m256d vy = _mm256_loadu_pd (y + i);
+		__m256d vz = _mm256_loadu_pd (z + i);
+		__m256d bd = _mm256_add_pd (_mm256_add_pd (_mm256_mul_pd (bx, vx),
+		                                           _mm256_mul_pd (by, vy)),
+		                            _mm256_mul_pd (bz, vz));
+		__m256d s = _mm256_sub_pd (_mm256_mul_pd (k, bd),
+		                           _mm256_mul_pd (g, vt));
+		_mm256_storeu_pd (t + i, _mm256_mul_pd (g, _mm256_sub_pd (vt, bd)));
+		_mm256_storeu_pd (x + i, _mm256_add_pd (vx, _mm256_mul_pd (s, bx)));
+		_mm256_storeu_pd (y + i, _mm256_add_pd (vy, _mm256_mul_pd (s, by)));
+		_mm256_storeu_pd (z + i, _mm256_add_pd (vz, _mm256_mul_pd (s, bz)));
+	}
+	return i;
+}
+
+PERL_LORENTZ_AVX2 static gsize
+velocity_add_avx2 (const gdouble * u, const gdouble * v, gdouble * w, gsize n)
+{
+	__m256d one = _mm256_set1_pd (1.0);
+	gsize i;
+
+	for (i = 0 ; i + 4 <= n ; i += 4) {
+		__m256d vu = _mm256_loadu_pd (u + i);
+		__m256d vv = _mm256_loadu_pd (v + i);
+		_mm256_storeu_pd (w + i,
+		                  _mm256_div_pd (_mm256_add_pd (vu, vv),
+		                                 _mm256_add_pd (one, _mm256_mul_pd (vu, vv))));
+	}
+	return i;
+}
+
+PERL_LORENTZ_AVX2 static gsize
+velocity_add_3_avx2 (const AddParams * p,
+                     gdouble * ux, gdouble * uy, gdouble * uz, gsize n)
+{
+	__m256d one = _mm256_set1_pd (1.0);
+	__m256d vx = _mm256_set1_pd (p->vx);
+	__m256d vy = _mm256_set1_pd (p->vy);
+	__m256d vz = _mm256_set1_pd (p->vz);
+	__m256d ig = _mm256_set1_pd (p->inv_gamma);
+	__m256d kk = _mm256_set1_pd (p->kk);
+	gsize i;
+
+	for (i = 0 ; i + 4 <= n ; i += 4) {
+		__m256d x = _mm256_loadu_pd (ux + i);
+		__m256d y = _mm256_loadu_pd (uy + i);
+		__m256d z = _mm256_loadu_pd (uz + i);
+		__m256d vu = _mm256_add_pd (_mm256_add_pd (_mm256_mul_pd (vx, x),
+		                                           _mm256_mul_pd (vy, y)),
+		                            _mm256_mul_pd (vz, z));
+		__m256d d = _mm256_add_pd (one, vu);
+		__m256d f = _mm256_add_pd (one, _mm256_mul_pd (kk, vu));
+		_mm256_storeu_pd (ux + i, _mm256_div_pd (_mm256_add_pd (_mm256_mul_pd (x, ig), _mm256_mul_pd (vx, f)), d));
+		_mm256_storeu_pd (uy + i, _mm256_div_pd (_mm256_add_pd (_mm256_mul_pd (y, ig), _mm256_mul_pd (vy, f)), d));
+		_mm256_storeu_pd (uz + i, _mm256_div_pd (_mm256_add_pd (_mm256_mul_pd (z, ig), _mm256_mul_pd (vz, f)), d));
+	}
+	return i;
+}
+
+PERL_LORENTZ_AVX2 static gsize
+gamma_avx2 (const gdouble * beta, gdouble * gamma, gsize n)
+{
+	__m256d one = _mm256_set1_pd (1.0);
+	gsize i;
+
+	for (i = 0 ; i + 4 <= n ; i += 4) {
+		__m256d b = _mm256_loadu_pd (beta + i);
+		__m256d q = _mm256_mul_pd (_mm256_sub_pd (one, b), _mm256_add_pd (one, b));
+		_mm256_storeu_pd (gamma + i, _mm256_div_pd (one, _mm256_sqrt_pd (q)));
+	}
+	return i;
+}
+
+PERL_LORENTZ_AVX2 static gsize
+rapidity_arg_avx2 (const gdouble * beta, gdouble * out, gsize n)
+{
+	__m256d one = _mm256_set1_pd (1.0);
+	gsize i;
+
+	for (i = 0 ; i + 4 <= n ; i += 4) {
+		__m256d b = _mm256_loadu_pd (beta + i);
+		_mm256_storeu_pd (out + i, _mm256_div_pd (_mm256_add_pd (b, b),
+		                                          _mm256_sub_pd (one, b)));
+	}
+	return i;
+}
+
+/*
+ * --- AVX-512 ----------------------------------------------------------------
+ */
+
+PERL_LORENTZ_AVX512 static gsize
+boost_avx512 (const BoostParams * p,
+              gdouble * t, gdouble * x, gdouble * y, gdouble * z, gsize n)
+{
+	__m512d bx = _mm512_set1_pd (p->bx);
+	__m512d by = _mm512_set1_pd (p->by);
+	__m512d bz = _mm512_set1_pd (p->bz);
+	__m512d g = _mm512_set1_pd (p->gamma);
+	__m512d k = _mm512_set1_pd (p->k);
+	gsize i;
+
+	for (i = 0 ; i + 8 <= n ; i += 8) {
+		__m512d vt = _mm512_loadu_pd (t + i);
+		__m512d vx = _mm512_loadu_pd (x + i);
+		__m512d vy = _mm512_loadu_pd (y + i);
+		__m512d vz = _mm512_loadu_pd (z + i);
+		__m512d bd = _mm512_add_pd (_mm512_add_pd (_mm512_mul_pd (bx, vx),
+		                                           _mm512_mul_pd (by, vy)),
+		                            _mm512_mul_pd (bz, vz));
+		__m512d s = _mm512_sub_pd (_mm512_mul_pd (k, bd),
+		                           _mm512_mul_pd (g, vt));
+		_mm512_storeu_pd (t + i, _mm512_mul_pd (g, _mm512_sub_pd (vt, bd)));
+		_mm512_storeu_pd (x + i, _mm512_add_pd (vx, _mm512_mul_pd (s, bx)));
+		_mm512_storeu_pd (y + i, _mm512_add_pd (vy, _mm512_mul_pd (s, by)));
+		_mm512_storeu_pd (z + i, _mm512_add_pd (vz, _mm512_mul_pd (s, bz)));
+	}
+	return i;
+}
+
+PERL_LORENTZ_AVX512 static gsize
+velocity_add_avx512 (const gdouble * u, const gdouble * v, gdouble * w, gsize n)
+{
+	__m512d one = _mm512_set1_pd (1.0);
+	gsize i;
+
+	for (i = 0 ; i + 8 <= n ; i += 8) {
+		__m512d vu = _mm512_loadu_pd (u + i);
+		__m512d vv = _mm512_loadu_pd (v + i);
+		_mm512_storeu_pd (w + i,
+		                  _mm512_div_pd (_mm512_add_pd (vu, vv),
+		                                 _mm512_add_pd (one, _mm512_mul_pd (vu, vv))));
+	}
+	return i;
+}
+
+PERL_LORENTZ_AVX512 static gsize
+velocity_add_3_avx512 (const AddParams * p,
+                       gdouble * ux, gdouble * uy, gdouble * uz, gsize n)
+{
+	__m512d one = _mm512_set1_pd (1.0);
+	__m512d vx = _mm512_set1_pd (p->vx);
+	__m512d vy = _mm512_set1_pd (p->vy);
+	__m512d vz = _mm512_set1_pd (p->vz);
+	__m512d ig = _mm512_set1_pd (p->inv_gamma);
+	__m512d kk = _mm512_set1_pd (p->kk);
+	gsize i;
+
+	for (i = 0 ; i + 8 <= n ; i += 8) {
+		__m512d x = _mm512_loadu_pd (ux + i);
+		__m512d y = _mm512_loadu_pd (uy + i);
+		__m512d z = _mm512_loadu_pd (uz + i);
+		__m512d vu = _mm512_add_pd (_mm512_add_pd (_mm512_mul_pd (vx, x),
+		                                           _mm512_mul_pd (vy, y)),
+		                            _mm512_mul_pd (vz, z));
+		__m512d d = _mm512_add_pd (one, vu);
+		__m512d f = _mm512_add_pd (one, _mm512_mul_pd (kk, vu));
+		_mm512_storeu_pd (ux + i, _mm512_div_pd (_mm512_add_pd (_mm512_mul_pd (x, ig), _mm512_mul_pd (vx, f)), d));
+		_mm512_storeu_pd (uy + i, _mm512_div_pd (_mm512_add_pd (_mm512_mul_pd (y, ig), _mm512_mul_pd (vy, f)), d));
+		_mm512_storeu_pd (uz + i, _mm512_div_pd (_mm512_add_pd (_mm512_mul_pd (z, ig), _mm512_mul_pd (vz, f)), d));
+	}
+	return i;
+}
+
+PERL_LORENTZ_AVX512 static gsize
+gamma_avx512 (const gdouble * beta, gdouble * gamma, gsize n)
+{
+	__m512d one = _mm512_set1_pd (1.0);
+	gsize i;
+
+	for (i = 0 ; i + 8 <= n ; i += 8) {
+		__m512d b = _mm512_loadu_pd (beta + i);
+		__m512d q = _mm512_mul_pd (_mm512_sub_pd (one, b), _mm512_add_pd (one, b));
+		_mm512_storeu_pd (gamma + i, _mm512_div_pd (one, _mm512_sqrt_pd (q)));
+	}
+	return i;
+}
+
+PERL_LORENTZ_AVX512 static gsize
+rapidity_arg_avx512 (const gdouble * beta, gdouble * out, gsize n)
+{
+	__m512d one = _mm512_set1_pd (1.0);
+	gsize i;
+
+	for (i = 0 ; i + 8 <= n ; i += 8) {
+		__m512d b = _mm512_loadu_pd (beta + i);
+		_mm512_storeu_pd (out + i, _mm512_div_pd (_mm512_add_pd (b, b),
+		                                          _mm512_sub_pd (one, b)));
+	}
+	return i;
+}
+
+#endif /* PERL_LORENTZ_HAVE_X86 */
+
+/*
+ * --- public entry points ----------------------------------------------------
+ */
+
+void
+perl_lorentz_boost (GPerlFourVectors * vectors,
+                     gdouble            bx,
+                     gdouble            by,
+                     gdouble            bz)
+{
+	BoostParams p;
+	gsize done = 0;
+
+	g_return_if_fail (vectors != NULL);
+
+	boost_params_init (&p, bx, by, bz);
+#ifdef PERL_LORENTZ_HAVE_X86
+	switch (perl_lorentz_get_isa ()) {
+	    case PERL_LORENTZ_ISA_AVX512:
+		done = boost_avx512 (&p, vectors->t, vectors->x, vectors->y,
+		                     vectors->z, vectors->n);
+		break;
+	    case PERL_LORENTZ_ISA_AVX2:
+		done = boost_avx2 (&p, vectors->t, vectors->x, vectors->y,
+		                   vectors->z, vectors->n);
+		break;
+	    default:
+		break;
+	}
+#endif
+	boost_scalar (&p, vectors->t, vectors->x, vectors->y, vectors->z,
+	              done, vectors->n);
+}
+
+void
+perl_lorentz_velocity_add (const gdouble * u,
+                            const gdouble * v,
+                            gdouble       * w,
+                            gsize           n)
+{
+	gsize done = 0;
+#ifdef PERL_LORENTZ_HAVE_X86
+	switch (perl_lorentz_get_isa ()) {
+	    case PERL_LORENTZ_ISA_AVX512:
+		done = velocity_add_avx512 (u, v, w, n);
+		break;
+	    case PERL_LORENTZ_ISA_AVX2:
+		done = velocity_add_avx2 (u, v, w, n);
+		break;
+	    default:
+		break;
+	}
+#endif
+	velocity_add_scalar (u, v, w, done, n);
+}
+
+void
+perl_lorentz_velocity_add_3 (gdouble * ux,
+                              gdouble * uy,
+                              gdouble * uz,
+                              gsize     n,
+                              gdouble   vx,
+                              gdouble   vy,
+                              gdouble   vz)
+{
+	AddParams p;
+	gsize done = 0;
+
+	add_params_init (&p, vx, vy, vz);
+#ifdef PERL_LORENTZ_HAVE_X86
+	switch (perl_lorentz_get_isa ()) {
+	    case PERL_LORENTZ_ISA_AVX512:
+		done = velocity_add_3_avx512 (&p, ux, uy, uz, n);
+		break;
+	    case PERL_LORENTZ_ISA_AVX2:
+		done = velocity_add_3_avx2 (&p, ux, uy, uz, n);
+		break;
+	    default:
+		break;
+	}
+#endif
+	velocity_add_3_scalar (&p, ux, uy, uz, done, n);
+}
+
+void
+perl_lorentz_gamma (const gdouble * beta, gdouble * gamma, gsize n)
+{
+	gsize done = 0;
+#ifdef PERL_LORENTZ_HAVE_X86
+	switch (perl_lorentz_get_isa ()) {
+	    case PERL_LORENTZ_ISA_AVX512:
+		done = gamma_avx512 (beta, gamma, n);
+		break;
+	    case PERL_LORENTZ_ISA_AVX2:
+		done = gamma_avx2 (beta, gamma, n);
+		break;
+	    default:
+		break;
+	}
+#endif
+	gamma_scalar (beta, gamma, done, n);
+}
+
+void
+perl_lorentz_rapidity (const gdouble * beta, gdouble * rapidity, gsize n)
+{
+	gsize i, done = 0;
+#ifdef PERL_LORENTZ_HAVE_X86
+	switch (perl_lorentz_get_isa ()) {
+	    case PERL_LORENTZ_ISA_AVX512:
+		done = rapidity_arg_avx512 (beta, rapidity, n);
+		break;
+	    case PERL_LORENTZ_ISA_AVX2:
+		done = rapidity_arg_avx2 (beta, rapidity, n);
+		break;
+	    default:
+		break;
+	}
+#endif
+	rapidity_arg_scalar (beta, rapidity, done, n);
+	for (i = 0 ; i < n ; i++)
+		rapidity[i] = 0.5 * log1p (rapidity[i]);
+}
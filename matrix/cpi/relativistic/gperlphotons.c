@@ -0,0 +1,323 @@
+/*
+ * parallel Monte Carlo engine for the photon reception-time experiment; see
+ * gperl_photons.h.
+ *
+ * reproducibility comes from three choices:
+ *
+ *  - random numbers come from Philox4x32-10, a counter-based generator.
+ *    event e always uses the block at counter e under the sweep's seed, so
+ *    it sees the same numbers whichever thread runs it and in whatever
+ *    order.
+ *  - histogram bins are integers, so merging the per-thread copies is
+ *    exact in any order.
+ *  - the running sum for the mean is kept per task and the task sums are
+ *    added up in task order at the end.
+ *
+ * scheduling is work stealing over ranges of task numbers.  each worker
+ * starts with an equal slice and pops tasks off the back of it; a worker
+ * that runs dry takes the front half of another worker's remaining range.
+ * nothing is allocated per event or per task.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "gperl_photons.h"
+
+#define DEFAULT_EVENTS_PER_TASK	65536
+
+/*
+ * --- Philox4x32-10 ----------------------------------------------------------
+ */
+
+#define PHILOX_M0	0xD2511F53u
+#define PHILOX_M1	0xCD9E8D57u
+#define PHILOX_W0	0x9E3779B9u
+#define PHILOX_W1	0xBB67AE85u
+
+static inline void
+philox4x32_10 (guint32 ctr[4], guint32 k0, guint32 k1)
+{
+	int round;
+	for (round = 0 ; round < 10 ; round++) {
+		guint64 p0 = (guint64) PHILOX_M0 * ctr[0];
+		guint64 p1 = (guint64) PHILOX_M1 * ctr[2];
+		guint32 c1 = ctr[1], c3 = ctr[3];
+		ctr[0] = (guint32) (p1 >> 32) ^ c1 ^ k0;
+		ctr[1] = (guint32) p1;
+		ctr[2] = (guint32) (p0 >> 32) ^ c3 ^ k1;
+		ctr[3] = (guint32) p0;
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+}
+
+/* uniform on [0, 1) with 53 random bits */
+static inline gdouble
+uniform_from_bits (guint32 hi, guint32 lo)
+{
+	return (gdouble) ((((guint64) hi << 32) | lo) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * --- physics ----------------------------------------------------------------
+ */
+
+typedef struct {
+	gdouble beta;
+	gdouble gamma;
+	gdouble beta_gamma;	/* x2, the second emission point */
+	gdouble distance;
+} Kinematics;
+
+static void
+kinematics_init (Kinematics * k, gdouble beta, gdouble distance)
+{
+	k->beta = beta;
+	k->gamma = 1.0 / sqrt ((1.0 - beta) * (1.0 + beta));
+	k->beta_gamma = beta * k->gamma;
+	k->distance = distance;
+}
+
+static inline gdouble
+event_delay (const Kinematics * k, gdouble cos_theta0)
+{
+	/* aberration into the observer's frame */
+	gdouble cos_theta = (cos_theta0 + k->beta) / (1.0 + k->beta * cos_theta0);
+	gdouble d = k->beta_gamma;
+	gdouble r = k->distance;
+	gdouble r2 = sqrt (r * r - 2.0 * r * d * cos_theta + d * d);
+	/* r2 - r without the cancellation, since r is usually huge */
+	return k->gamma + (d * d - 2.0 * r * d * cos_theta) / (r2 + r);
+}
+
+gdouble
+perl_photon_delay (gdouble beta, gdouble distance, gdouble cos_theta0)
+{
+	Kinematics k;
+	kinematics_init (&k, beta, distance);
+	return event_delay (&k, cos_theta0);
+}
+
+/*
+ * --- scheduler --------------------------------------------------------------
+ */
+
+typedef struct {
+	GMutex  lock;
+	guint64 head;	/* tasks [head, tail) are still queued */
+	guint64 tail;
+} TaskRange;
+
+typedef struct _Worker Worker;
+typedef struct _Sweep Sweep;
+
+struct _Worker {
+	Sweep   * sweep;
+	guint     index;
+	TaskRange queue;
+	guint64 * bins;
+	guint64   underflow;
+	guint64   overflow;
+	GThread * thread;
+};
+
+struct _Sweep {
+	Kinematics kin;
+	guint64    n_events;
+	guint64    events_per_task;
+	guint64    n_tasks;
+	guint32    key[2];
+	gdouble    hist_min;
+	gdouble    hist_scale;
+	guint      n_bins;
+	gdouble  * task_sums;
+	Worker   * workers;
+	guint      n_workers;
+};
+
+static void
+run_task (Worker * w, guint64 task)
+{
+	Sweep * s = w->sweep;
+	guint64 e = task * s->events_per_task;
+	guint64 end = e + MIN (s->events_per_task, s->n_events - e);
+	gdouble sum = 0.0;
+
+	for ( ; e < end ; e++) {
+		guint32 ctr[4] = { (guint32) e, (guint32) (e >> 32), 0, 0 };
+		gdouble dt, bin;
+
+		philox4x32_10 (ctr, s->key[0], s->key[1]);
+		dt = event_delay (&s->kin,
+		                  2.0 * uniform_from_bits (ctr[0], ctr[1]) - 1.0);
+		sum += dt;
+
+		bin = (dt - s->hist_min) * s->hist_scale;
+		if (bin < 0.0)
+			w->underflow++;
+		else if (!(bin < s->n_bins))	/* also catches NaN */
+			w->overflow++;
+		else
+			w->bins[(guint) bin]++;
+	}
+	s->task_sums[task] = sum;
+}
+
+static gboolean
+pop_task (Worker * w, guint64 * task)
+{
+	gboolean found = FALSE;
+	g_mutex_lock (&w->queue.lock);
+	if (w->queue.head < w->queue.tail) {
+		*task = --w->queue.tail;
+		found = TRUE;
+	}
+	g_mutex_unlock (&w->queue.lock);
+	return found;
+}
+
+/* move the front half of some other worker's range into our own queue. */
+static gboolean
+steal_tasks (Worker * thief)
+{
+	Sweep * s = thief->sweep;
+	guint i;
+
+	for (i = 1 ; i < s->n_workers ; i++) {
+		Worker * victim = &s->workers[(thief->index + i) % s->n_workers];
+		guint64 head = 0, n = 0;
+
+		g_mutex_lock (&victim->queue.lock);
+		if (victim->queue.head < victim->queue.tail) {
+			n = (victim->queue.tail - victim->queue.head + 1) / 2;
+			head = victim->queue.head;
+			victim->queue.head += n;
+		}
+		g_mutex_unlock (&victim->queue.lock);
+
+		if (n) {
+			g_mutex_lock (&thief->queue.lock);
+			thief->queue.head = head;
+			thief->queue.tail = head + n;
+			g_mutex_unlock (&thief->queue.lock);
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+static gpointer
+worker_main (gpointer data)
+{
+	Worker * w = data;
+	guint64 task;
+
+	/* tasks are never created once the sweep starts, so a full pass over
+	 * the other queues that finds nothing means we are done. */
+	do {
+		while (pop_task (w, &task))
+			run_task (w, task);
+	} while (steal_tasks (w));
+
+	return NULL;
+}
+
+/*
+ * --- public entry points ----------------------------------------------------
+ */
+
+gboolean
+perl_photon_sweep_run (const GPerlPhotonSweep * params,
+                        GPerlPhotonHistogram   * histogram)
+{
+	Sweep s;
+	guint i, b, n_threads;
+	guint64 t;
+	gdouble total;
+
+	g_return_val_if_fail (params != NULL, FALSE);
+	g_return_val_if_fail (histogram != NULL, FALSE);
+
+	memset (histogram, 0, sizeof (*histogram));
+	if (!(params->beta >= 0.0 && params->beta < 1.0) ||
+	    !(params->distance > 0.0) ||
+	    !(params->hist_max > params->hist_min) ||
+	    params->n_bins == 0)
+		return FALSE;
+
+	kinematics_init (&s.kin, params->beta, params->distance);
+	s.n_events = params->n_events;
+	s.events_per_task = params->events_per_task
+	                  ? params->events_per_task
+	                  : DEFAULT_EVENTS_PER_TASK;
+	/* a task never needs more than every event; capping it there keeps
+	 * task * events_per_task from wrapping. */
+	s.events_per_task = MIN (s.events_per_task, MAX (s.n_events, 1));
+	s.n_tasks = s.n_events / s.events_per_task
+	          + (s.n_events % s.events_per_task != 0);
+	s.key[0] = (guint32) params->seed;
+	s.key[1] = (guint32) (params->seed >> 32);
+	s.hist_min = params->hist_min;
+	s.hist_scale = params->n_bins / (params->hist_max - params->hist_min);
+	s.n_bins = params->n_bins;
+	s.task_sums = g_new0 (gdouble, MAX (s.n_tasks, 1));
+
+	n_threads = params->n_threads ? params->n_threads : g_get_num_processors ();
+	s.n_workers = (guint) CLAMP (s.n_tasks, 1, n_threads);
+	s.workers = g_new0 (Worker, s.n_workers);
+
+	for (i = 0 ; i < s.n_workers ; i++) {
+		Worker * w = &s.workers[i];
+		w->sweep = &s;
+		w->index = i;
+		g_mutex_init (&w->queue.lock);
+		w->queue.head = s.n_tasks * i / s.n_workers;
+		w->queue.tail = s.n_tasks * (i + 1) / s.n_workers;
+		w->bins = g_new0 (guint64, s.n_bins);
+	}
+
+	/* the calling thread is worker 0. */
+	for (i = 1 ; i < s.n_workers ; i++)
+		s.workers[i].thread = g_thread_new ("photon-sweep",
+		                                    worker_main, &s.workers[i]);
+	worker_main (&s.workers[0]);
+
+	histogram->min = params->hist_min;
+	histogram->max = params->hist_max;
+	histogram->n_bins = s.n_bins;
+	histogram->bins = s.workers[0].bins;
+	histogram->n_events = s.n_events;
+	histogram->underflow = s.workers[0].underflow;
+	histogram->overflow = s.workers[0].overflow;
+
+	for (i = 1 ; i < s.n_workers ; i++) {
+		Worker * w = &s.workers[i];
+		g_thread_join (w->thread);
+		for (b = 0 ; b < s.n_bins ; b++)
+			histogram->bins[b] += w->bins[b];
+		histogram->underflow += w->underflow;
+		histogram->overflow += w->overflow;
+		g_free (w->bins);
+		g_mutex_clear (&w->queue.lock);
+	}
+	/* only now is no thief left to lock worker 0's queue. */
+	g_mutex_clear (&s.workers[0].queue.lock);
+
+	total = 0.0;
+	for (t = 0 ; t < s.n_tasks ; t++)
+		total += s.task_sums[t];
+	histogram->mean = s.n_events ? total / s.n_events : 0.0;
+
+	g_free (s.task_sums);
+	g_free (s.workers);
+	return TRUE;
+}
+
+void
+perl_photon_histogram_clear (GPerlPhotonHistogram * histogram)
+{
+	g_return_if_fail (histogram != NULL);
+	g_free (histogram->bins);
+	memset (histogram, 0, sizeof (*histogram));
+}
@@ -0,0 +1,95 @@
+/*
+ * per-class GParamSpec cache and batched property access; see
+ * gperl_properties.h.
+ */
+
+#include "gperl_properties.h"
+
+/* GType -> (name -> GParamSpec) */
+static GHashTable * property_caches = NULL;
+G_LOCK_DEFINE_STATIC (property_caches);
+
+static GHashTable *
+class_cache_new (void)
+{
+	return g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+	                              (GDestroyNotify) g_param_spec_unref);
+}
+
+GParamSpec *
+perl_object_find_property (GType type, const char * name)
+{
+	GHashTable * cache;
+	GParamSpec * pspec;
+
+	g_return_val_if_fail (name != NULL, NULL);
+
+	G_LOCK (property_caches);
+
+	if (!property_caches)
+		property_caches = g_hash_table_new_full
+				(g_direct_hash, g_direct_equal, NULL,
+				 (GDestroyNotify) g_hash_table_destroy);
+
+	cache = g_hash_table_lookup (property_caches, (gpointer) type);
+	if (!cache) {
+		cache = class_cache_new ();
+		g_hash_table_insert (property_caches, (gpointer) type, cache);
+	}
+
+	pspec = g_hash_table_lookup (cache, name);
+	if (!pspec) {
+		/* misses are not cached; asking for a property that does not
+		 * exist is an error the caller reports anyway. */
+		pspec = g_object_class_find_property (perl_type_class (type), name);
+		if (pspec)
+			g_hash_table_insert (cache, g_strdup (name),
+			                     g_param_spec_ref (pspec));
+	}
+
+	G_UNLOCK (property_caches);
+
+	return pspec;
+}
+
+void
+perl_object_property_cache_clear (void)
+{
+	G_LOCK (property_caches);
+	if (property_caches)
+		g_hash_table_remove_all (property_caches);
+	G_UNLOCK (property_caches);
+}
+
+void
+perl_object_get_properties (GObject     * object,
+                             guint         n_properties,
+                             GParamSpec ** pspecs,
+                             GValue      * values)
+{
+	guint i;
+
+	g_return_if_fail (G_IS_OBJECT (object));
+
+	for (i = 0 ; i < n_properties ; i++) {
+		g_value_init (&values[i], G_PARAM_SPEC_VALUE_TYPE (pspecs[i]));
+		/* the canonical name keeps glib from copying and rewriting it. */
+		g_object_get_property (object, pspecs[i]->name, &values[i]);
+	}
+}
+
+void
+perl_object_set_properties (GObject      * object,
+                             guint          n_properties,
+                             GParamSpec  ** pspecs,
+                             const GValue * values)
+{
+	guint i;
+
+	g_return_if_fail (G_IS_OBJECT (object));
+
+	g_object_freeze_notify (object);
+	for (i = 0 ; i < n_properties ; i++)
+		g_object_set_property (object, pspecs[i]->name, &values[i]);
+	g_object_thaw_notify (object);
+}
@@ -0,0 +1,250 @@
+/*
+ * @ISA management and batched type registration; see gperl_registration.h.
+ */
+
+#include "gperl_registration.h"
+
+typedef struct {
+	GPerlRegistrationKind kind;
+	GType                 type;
+	char                * package;
+	gpointer              wrapper_class;
+} Registration;
+
+typedef struct {
+	char    * parent;
+	gboolean  prepend;
+} Edge;
+
+typedef struct {
+	char   * package;
+	GArray * edges;	/* Edge, in the order they were asked for */
+} Child;
+
+static guint batch_depth = 0;
+static GArray * registrations = NULL;	/* Registration */
+static GPtrArray * children = NULL;	/* Child, in first-seen order */
+static GHashTable * children_by_package = NULL;
+
+static void
+run_registration (GPerlRegistrationKind kind,
+                  GType                 type,
+                  const char          * package,
+                  gpointer              wrapper_class)
+{
+	switch (kind) {
+	    case PERL_REGISTRATION_OBJECT:
+		perl_register_object (type, package);
+		break;
+	    case PERL_REGISTRATION_BOXED:
+		perl_register_boxed (type, package, wrapper_class);
+		break;
+	    case PERL_REGISTRATION_FUNDAMENTAL:
+		if (wrapper_class)
+			perl_register_fundamental_full (type, package,
+			                                 wrapper_class);
+		else
+			perl_register_fundamental (type, package);
+		break;
+	    case PERL_REGISTRATION_PARAM_SPEC:
+		perl_register_param_spec (type, package);
+		break;
+	}
+}
+
+static AV *
+get_isa (const char * package)
+{
+	dTHX;
+	char * name = g_strconcat (package, "::ISA", NULL);
+	AV * isa = get_av (name, TRUE); /* create on demand */
+	g_free (name);
+	return isa;
+}
+
+static void
+store_edge (AV * isa, const char * parent, gboolean prepend)
+{
+	dTHX;
+	if (prepend) {
+		av_unshift (isa, 1);
+		av_store (isa, 0, newSVpv (parent, 0));
+	} else {
+		av_push (isa, newSVpv (parent, 0));
+	}
+}
+
+static void
+defer_edge (const char * child_package, const char * parent_package,
+            gboolean prepend)
+{
+	Child * child;
+	Edge edge;
+
+	child = g_hash_table_lookup (children_by_package, child_package);
+	if (!child) {
+		child = g_new (Child, 1);
+		child->package = g_strdup (child_package);
+		child->edges = g_array_new (FALSE, FALSE, sizeof (Edge));
+		g_ptr_array_add (children, child);
+		g_hash_table_insert (children_by_package, child->package, child);
+	}
+	edge.parent = g_strdup (parent_package);
+	edge.prepend = prepend;
+	g_array_append_val (child->edges, edge);
+}
+
+void
+perl_set_isa (const char * child_package, const char * parent_package)
+{
+	if (batch_depth)
+		defer_edge (child_package, parent_package, FALSE);
+	else
+		store_edge (get_isa (child_package), parent_package, FALSE);
+}
+
+void
+perl_prepend_isa (const char * child_package, const char * parent_package)
+{
+	if (batch_depth)
+		defer_edge (child_package, parent_package, TRUE);
+	else
+		store_edge (get_isa (child_package), parent_package, TRUE);
+}
+
+void
+perl_registration_begin (void)
+{
+	if (batch_depth++)
+		return;
+	registrations = g_array_new (FALSE, FALSE, sizeof (Registration));
+	children = g_ptr_array_new ();
+	children_by_package = g_hash_table_new (g_str_hash, g_str_equal);
+}
+
+void
+perl_registration_add (GPerlRegistrationKind kind,
+                        GType                 type,
+                        const char          * package,
+                        gpointer              wrapper_class)
+{
+	Registration r;
+
+	if (!batch_depth) {
+		run_registration (kind, type, package, wrapper_class);
+		return;
+	}
+	r.kind = kind;
+	r.type = type;
+	r.package = g_strdup (package);
+	r.wrapper_class = wrapper_class;
+	g_array_append_val (registrations, r);
+}
+
+/* drops everything the outermost batch queued, and closes it.  runs when
+ * the commit leaves its scope, including by a croak from a registration or
+ * from method resolution, so a failed commit cannot leave later
+ * perl_set_isa calls deferred forever. */
+static void
+batch_free (pTHX_ void * unused)
+{
+	guint i, j;
+
+	PERL_UNUSED_VAR (unused);
+	for (i = 0 ; i < registrations->len ; i++)
+		g_free (g_array_index (registrations, Registration, i).package);
+	for (i = 0 ; i < children->len ; i++) {
+		Child * child = g_ptr_array_index (children, i);
+		for (j = 0 ; j < child->edges->len ; j++)
+			g_free (g_array_index (child->edges, Edge, j).parent);
+		g_array_free (child->edges, TRUE);
+		g_free (child->package);
+		g_free (child);
+	}
+	g_hash_table_destroy (children_by_package);
+	g_ptr_array_free (children, TRUE);
+	g_array_free (registrations, TRUE);
+	children_by_package = NULL;
+	children = NULL;
+	registrations = NULL;
+	batch_depth = 0;
+}
+
+void
+perl_registration_commit (GPerlRegistrationStats * stats)
+{
+	dTHX;
+	GPerlRegistrationStats s = { 0, };
+	gint64 t0, t1, t2, t3;
+	AV ** isas;
+	guint i, j;
+
+	g_return_if_fail (batch_depth > 0);
+
+	if (--batch_depth) {
+		if (stats)
+			*stats = s;
+		return;
+	}
+
+	ENTER;
+	SAVEDESTRUCTOR_X (batch_free, NULL);
+
+	/* the registrations themselves call perl_set_isa, so keep deferring
+	 * edges until they are all done. */
+	batch_depth++;
+	t0 = g_get_monotonic_time ();
+	for (i = 0 ; i < registrations->len ; i++) {
+		Registration * r = &g_array_index (registrations, Registration, i);
+		run_registration (r->kind, r->type, r->package, r->wrapper_class);
+	}
+	s.n_registrations = registrations->len;
+	batch_depth--;
+
+	/* with PL_delaymagic set, stores into @ISA only note that the array
+	 * changed instead of recomputing method resolution right away. */
+	t1 = g_get_monotonic_time ();
+	Newxz (isas, children->len, AV *);
+	SAVEFREEPV (isas);
+	ENTER;
+	SAVEI16 (PL_delaymagic);
+	for (i = 0 ; i < children->len ; i++) {
+		Child * child = g_ptr_array_index (children, i);
+		AV * isa = isas[i] = get_isa (child->package);
+
+		PL_delaymagic = DM_DELAY;
+		for (j = 0 ; j < child->edges->len ; j++) {
+			Edge * edge = &g_array_index (child->edges, Edge, j);
+			store_edge (isa, edge->parent, edge->prepend);
+		}
+
+		s.n_edges += child->edges->len;
+	}
+	LEAVE;
+
+	/* children are visited in the order their first edge was recorded,
+	 * which for boot code is parents first, so each linearization is
+	 * computed against already updated parents.  this is the same set
+	 * magic perl itself runs once a delayed list assignment is done. */
+	t2 = g_get_monotonic_time ();
+	for (i = 0 ; i < children->len ; i++)
+		SvSETMAGIC ((SV *) isas[i]);
+	s.n_classes = children->len;
+	t3 = g_get_monotonic_time ();
+
+	s.register_time = t1 - t0;
+	s.isa_time = t2 - t1;
+	s.mro_time = t3 - t2;
+
+	LEAVE;
+
+	if (g_getenv ("GPERL_REGISTRATION_TIMING"))
+		g_printerr ("registration: %u types in %" G_GINT64_FORMAT " us, "
+		            "%u isa edges in %" G_GINT64_FORMAT " us, "
+		            "%u classes resolved in %" G_GINT64_FORMAT " us\n",
+		            s.n_registrations, s.register_time,
+		            s.n_edges, s.isa_time,
+		            s.n_classes, s.mro_time);
+	if (stats)
+		*stats = s;
+}
@@ -0,0 +1,425 @@
+/*
+ * batched perl idle and timeout callbacks; see gperl_scheduler.h.
+ */
+
+#include <string.h>
+
+#include "gperl_scheduler.h"
+
+#if GLIB_CHECK_VERSION (2, 28, 0)
+
+typedef struct _Band Band;
+
+typedef struct {
+	guint    id;
+	Band   * band;
+	guint    interval;	/* milliseconds, 0 for idle */
+	gint64   due;		/* monotonic; for idles, when queued */
+	guint64  serial;	/* when queued, in band->serial */
+	gboolean running;	/* out of the queues while its callback runs */
+	gboolean removed;
+	SV     * callback;
+	SV     * data;
+} Job;
+
+/* all the callbacks of one priority, and the source that runs them. */
+struct _Band {
+	GSource          source;
+	GPerlScheduler * scheduler;
+	GQueue           idle;		/* Job, first in first out */
+	GQueue           timers;	/* Job, by due time */
+	guint64          serial;	/* counts queuings */
+};
+
+struct _GPerlScheduler {
+	GMainContext      * context;
+	gint64              budget;
+	GHashTable        * bands;	/* priority -> Band */
+	GHashTable        * jobs;	/* id -> Job */
+	guint               last_id;
+	GPerlSchedulerStats stats;
+#ifdef PERL_IMPLICIT_CONTEXT
+	void              * perl;
+#endif
+};
+
+/*
+ * --- jobs -------------------------------------------------------------------
+ */
+
+static void
+job_free (Job * job)
+{
+#ifdef PERL_IMPLICIT_CONTEXT
+	PERL_SET_CONTEXT (job->band->scheduler->perl);
+#endif
+	{
+	dTHX;
+	g_hash_table_remove (job->band->scheduler->jobs,
+	                     GUINT_TO_POINTER (job->id));
+	SvREFCNT_dec (job->callback);
+	SvREFCNT_dec (job->data);
+	}
+	g_free (job);
+}
+
+static gint
+compare_due (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	gint64 da = ((const Job *) a)->due, db = ((const Job *) b)->due;
+	PERL_UNUSED_VAR (user_data);
+	return da < db ? -1 : da > db ? 1 : 0;
+}
+
+static void
+job_queue (Job * job)
+{
+	job->serial = job->band->serial++;
+	if (job->interval)
+		g_queue_insert_sorted (&job->band->timers, job, compare_due, NULL);
+	else
+		g_queue_push_tail (&job->band->idle, job);
+}
+
+/* returns whether the job wants to stay scheduled. */
+static gboolean
+job_run (pTHX_ Job * job)
+{
+	dSP;
+	SV * save_err;
+	gboolean keep;
+
+	/* mortal so it will die if not stolen by SvSetSV. */
+	save_err = sv_2mortal (newSVsv (ERRSV));
+
+	PUSHMARK (SP);
+	if (job->data)
+		XPUSHs (job->data);
+	PUTBACK;
+
+	call_sv (job->callback, G_SCALAR | G_EVAL);
+
+	SPAGAIN;
+	keep = SvTRUE (POPs);
+	PUTBACK;
+
+	if (SvTRUE (ERRSV)) {
+		perl_run_exception_handlers ();
+		keep = FALSE;
+	}
+	SvSetSV (ERRSV, save_err);
+
+	return keep;
+}
+
+/*
+ * --- the band source --------------------------------------------------------
+ */
+
+static gboolean
+band_prepare (GSource * source, gint * timeout)
+{
+	Band * band = (Band *) source;
+	Job * timer;
+
+	if (!g_queue_is_empty (&band->idle)) {
+		*timeout = 0;
+		return TRUE;
+	}
+
+	timer = g_queue_peek_head (&band->timers);
+	if (!timer) {
+		*timeout = -1;
+		return FALSE;
+	} else {
+		gint64 wait = timer->due - g_source_get_time (source);
+		if (wait <= 0) {
+			*timeout = 0;
+			return TRUE;
+		}
+		*timeout = MIN ((wait + 999) / 1000, G_MAXINT);
+		return FALSE;
+	}
+}
+
+static gboolean
+band_check (GSource * source)
+{
+	Band * band = (Band *) source;
+	Job * timer;
+
+	if (!g_queue_is_empty (&band->idle))
+		return TRUE;
+	timer = g_queue_peek_head (&band->timers);
+	return timer && timer->due <= g_source_get_time (source);
+}
+
+/* the next job of the batch that started at start, when the band had
+ * queued serial jobs: idles queued before then, and timers due by then.
+ * jobs stay on the queues until they run, so a main loop nested inside a
+ * callback can dispatch the band again and run them from there. */
+static Job *
+pop_due (Band * band, gint64 start, guint64 serial)
+{
+	Job * job = g_queue_peek_head (&band->idle);
+	if (job && job->serial < serial)
+		return g_queue_pop_head (&band->idle);
+	job = g_queue_peek_head (&band->timers);
+	if (job && job->due <= start)
+		return g_queue_pop_head (&band->timers);
+	return NULL;
+}
+
+static guint
+count_due (Band * band, gint64 start, guint64 serial)
+{
+	GList * l;
+	guint n = 0;
+	for (l = band->idle.head ; l && ((Job *) l->data)->serial < serial ; l = l->next)
+		n++;
+	for (l = band->timers.head ; l && ((Job *) l->data)->due <= start ; l = l->next)
+		n++;
+	return n;
+}
+
+static gboolean
+band_dispatch (GSource * source, GSourceFunc callback, gpointer user_data)
+{
+	Band * band = (Band *) source;
+	GPerlScheduler * scheduler = band->scheduler;
+	GPerlSchedulerStats * stats = &scheduler->stats;
+	gint64 start, now, deadline;
+	guint64 serial;
+	guint ran = 0;
+	Job * job;
+
+	PERL_UNUSED_VAR (callback);
+	PERL_UNUSED_VAR (user_data);
+
+#ifdef PERL_IMPLICIT_CONTEXT
+	/* make sure we're executed by the same interpreter that created
+	 * the scheduler. */
+	PERL_SET_CONTEXT (scheduler->perl);
+#endif
+	{
+	dTHX;
+
+	/* the batch is what is due now; anything the callbacks queue runs
+	 * in a later one, so a callback that keeps re-adding itself cannot
+	 * hold the loop. */
+	start = now = g_get_monotonic_time ();
+	deadline = start + scheduler->budget;
+	serial = band->serial;
+
+	ENTER;
+	SAVETMPS;
+
+	for (;;) {
+		gboolean keep;
+
+		/* a batch always runs at least one callback */
+		if (ran && now >= deadline) {
+			guint deferred = count_due (band, start, serial);
+			if (deferred) {
+				stats->n_deferred += deferred;
+				stats->n_over_budget++;
+			}
+			break;
+		}
+		job = pop_due (band, start, serial);
+		if (!job)
+			break;
+
+		if (now - job->due > stats->max_lateness_usec)
+			stats->max_lateness_usec = now - job->due;
+		stats->total_lateness_usec += MAX (now - job->due, 0);
+		stats->n_callbacks++;
+		ran++;
+
+		job->running = TRUE;
+		keep = job_run (aTHX_ job);
+		job->running = FALSE;
+		/* the batch holds one scope, but temporaries still go after
+		 * every callback */
+		FREETMPS;
+		now = g_get_monotonic_time ();
+
+		if (keep && !job->removed) {
+			job->due = job->interval
+			         ? now + (gint64) job->interval * 1000
+			         : now;
+			job_queue (job);
+		} else {
+			if (!job->removed)
+				stats->n_pending--;
+			job_free (job);
+		}
+	}
+
+	LEAVE;
+	}
+
+	stats->n_batches++;
+	if (now - start > stats->max_batch_usec)
+		stats->max_batch_usec = now - start;
+
+	/* the band lives as long as the scheduler */
+	return TRUE;
+}
+
+static GSourceFuncs band_funcs = {
+	band_prepare,
+	band_check,
+	band_dispatch,
+	NULL
+};
+
+static Band *
+get_band (GPerlScheduler * scheduler, gint priority)
+{
+	Band * band = g_hash_table_lookup (scheduler->bands,
+	                                   GINT_TO_POINTER (priority));
+	if (!band) {
+		band = (Band *) g_source_new (&band_funcs, sizeof (Band));
+		band->scheduler = scheduler;
+		g_queue_init (&band->idle);
+		g_queue_init (&band->timers);
+		g_source_set_priority (&band->source, priority);
+		/* a callback running a nested main loop must not hold up the
+		 * rest of its priority */
+		g_source_set_can_recurse (&band->source, TRUE);
+		g_source_attach (&band->source, scheduler->context);
+		g_hash_table_insert (scheduler->bands,
+		                     GINT_TO_POINTER (priority), band);
+	}
+	return band;
+}
+
+/*
+ * --- the scheduler ----------------------------------------------------------
+ */
+
+GPerlScheduler *
+perl_scheduler_new (GMainContext * context, gint64 budget_usec)
+{
+	GPerlScheduler * scheduler = g_new0 (GPerlScheduler, 1);
+
+	scheduler->context = context ? g_main_context_ref (context) : NULL;
+	scheduler->budget = budget_usec;
+	scheduler->bands = g_hash_table_new (g_direct_hash, g_direct_equal);
+	scheduler->jobs = g_hash_table_new (g_direct_hash, g_direct_equal);
+#ifdef PERL_IMPLICIT_CONTEXT
+	{
+		dTHX;
+		scheduler->perl = aTHX;
+	}
+#endif
+	return scheduler;
+}
+
+GPerlScheduler *
+perl_scheduler_get_default (void)
+{
+	static GPerlScheduler * scheduler = NULL;
+	if (!scheduler)
+		scheduler = perl_scheduler_new (NULL,
+		                                PERL_SCHEDULER_DEFAULT_BUDGET);
+	return scheduler;
+}
+
+void
+perl_scheduler_destroy (GPerlScheduler * scheduler)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	g_hash_table_iter_init (&iter, scheduler->bands);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		Band * band = value;
+		Job * job;
+		while ((job = g_queue_pop_head (&band->idle)))
+			job_free (job);
+		while ((job = g_queue_pop_head (&band->timers)))
+			job_free (job);
+		g_source_destroy (&band->source);
+		g_source_unref (&band->source);
+	}
+	g_hash_table_destroy (scheduler->bands);
+	g_hash_table_destroy (scheduler->jobs);
+	if (scheduler->context)
+		g_main_context_unref (scheduler->context);
+	g_free (scheduler);
+}
+
+void
+perl_scheduler_set_budget (GPerlScheduler * scheduler, gint64 budget_usec)
+{
+	scheduler->budget = budget_usec;
+}
+
+gint64
+perl_scheduler_get_budget (GPerlScheduler * scheduler)
+{
+	return scheduler->budget;
+}
+
+guint
+perl_scheduler_add (GPerlScheduler * scheduler,
+                    gint             priority,
+                    guint            interval,
+                    SV             * callback,
+                    SV             * data)
+{
+	dTHX;
+	Job * job = g_new0 (Job, 1);
+
+	do
+		job->id = ++scheduler->last_id;
+	while (!job->id || g_hash_table_lookup (scheduler->jobs,
+	                                        GUINT_TO_POINTER (job->id)));
+	job->band = get_band (scheduler, priority);
+	job->interval = interval;
+	job->due = g_get_monotonic_time () + (gint64) interval * 1000;
+	job->callback = newSVsv (callback);
+	job->data = perl_sv_is_defined (data) ? newSVsv (data) : NULL;
+
+	g_hash_table_insert (scheduler->jobs, GUINT_TO_POINTER (job->id), job);
+	job_queue (job);
+	scheduler->stats.n_pending++;
+
+	return job->id;
+}
+
+gboolean
+perl_scheduler_remove (GPerlScheduler * scheduler, guint id)
+{
+	Job * job = g_hash_table_lookup (scheduler->jobs, GUINT_TO_POINTER (id));
+
+	if (!job || job->removed)
+		return FALSE;
+	scheduler->stats.n_pending--;
+	if (job->running) {
+		/* freed by the batch as soon as the callback returns */
+		job->removed = TRUE;
+		return TRUE;
+	}
+	g_queue_remove (job->interval ? &job->band->timers : &job->band->idle,
+	                job);
+	job_free (job);
+	return TRUE;
+}
+
+void
+perl_scheduler_get_stats (GPerlScheduler      * scheduler,
+                          GPerlSchedulerStats * stats,
+                          gboolean              reset)
+{
+	*stats = scheduler->stats;
+	if (reset) {
+		guint n_pending = scheduler->stats.n_pending;
+		memset (&scheduler->stats, 0, sizeof (GPerlSchedulerStats));
+		scheduler->stats.n_pending = n_pending;
+	}
+}
+
+#endif /* 2.28.0 */
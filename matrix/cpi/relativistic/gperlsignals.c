@@ -0,0 +1,395 @@
+/*
+ * cached signal introspection; see gperl_signals.h.
+ */
+
+#include "gperl_signals.h"
+
+/*
+ * both caches use the same key.  queries and signatures are keyed by
+ * (instance type, signal id); invocation hints by (signal id, detail, run
+ * type), since those are all a hint depends on.
+ */
+typedef struct {
+	GType  type;
+	guint  signal_id;
+	GQuark detail;
+	guint  run_type;
+} CacheKey;
+
+typedef struct {
+	CacheKey               key;
+	GType                  itype;	/* the defining type, for invalidation */
+	GPerlSignalSignature * signature;
+	HV                   * hv;	/* built lazily, read-only */
+#ifdef PERL_IMPLICIT_CONTEXT
+	PerlInterpreter      * perl;	/* the one hv belongs to */
+#endif
+} CacheEntry;
+
+static GHashTable * queries = NULL;
+static GHashTable * hints = NULL;
+#ifdef PERL_IMPLICIT_CONTEXT
+/* the cached SVs belong to the interpreter that built them; any other
+ * interpreter gets fresh hashes. */
+static PerlInterpreter * owner = NULL;
+#endif
+G_LOCK_DEFINE_STATIC (signal_cache);
+
+static guint
+cache_key_hash (gconstpointer p)
+{
+	const CacheKey * key = p;
+	return (guint) key->type * 31u
+	     + key->signal_id * 17u
+	     + key->detail * 7u
+	     + key->run_type;
+}
+
+static gboolean
+cache_key_equal (gconstpointer a, gconstpointer b)
+{
+	const CacheKey * ka = a;
+	const CacheKey * kb = b;
+	return ka->type == kb->type
+	    && ka->signal_id == kb->signal_id
+	    && ka->detail == kb->detail
+	    && ka->run_type == kb->run_type;
+}
+
+static void
+release_hv (pTHX_ HV * hv)
+{
+	/* unlock the hash before handing it back to perl. */
+	SvREADONLY_off ((SV *) hv);
+	SvREFCNT_dec ((SV *) hv);
+}
+
+/* invalidation may come from any thread, so the hash is released in the
+ * interpreter that built it. */
+static void
+cache_entry_free (CacheEntry * entry)
+{
+	if (entry->hv) {
+#ifdef PERL_IMPLICIT_CONTEXT
+		PerlInterpreter * current = PERL_GET_CONTEXT;
+		PERL_SET_CONTEXT (entry->perl);
+		{
+			dTHX;
+			release_hv (aTHX_ entry->hv);
+		}
+		PERL_SET_CONTEXT (current);
+#else
+		dTHX;
+		release_hv (aTHX_ entry->hv);
+#endif
+	}
+	g_free (entry->signature);
+	g_free (entry);
+}
+
+static void
+ensure_tables (void)
+{
+	if (queries)
+		return;
+	queries = g_hash_table_new_full (cache_key_hash, cache_key_equal, NULL,
+	                                 (GDestroyNotify) cache_entry_free);
+	hints = g_hash_table_new_full (cache_key_hash, cache_key_equal, NULL,
+	                               (GDestroyNotify) cache_entry_free);
+}
+
+static GPerlSignalSignature *
+signature_new (const GSignalQuery * query)
+{
+	GPerlSignalSignature * signature;
+	GType * types;
+	guint i;
+
+	/* one block: the struct, then param_types, then param_fundamentals */
+	signature = g_malloc0 (sizeof (GPerlSignalSignature)
+	                       + 2 * query->n_params * sizeof (GType));
+	types = (GType *) (signature + 1);
+
+	signature->signal_id = query->signal_id;
+	signature->signal_name = query->signal_name;
+	signature->itype = query->itype;
+	signature->flags = query->signal_flags;
+	signature->return_type = query->return_type & ~G_SIGNAL_TYPE_STATIC_SCOPE;
+	signature->n_params = query->n_params;
+	signature->param_types = types;
+	signature->param_fundamentals = types + query->n_params;
+
+	for (i = 0 ; i < query->n_params ; i++) {
+		GType t = query->param_types[i];
+		if (i < 32 && (t & G_SIGNAL_TYPE_STATIC_SCOPE))
+			signature->static_scope |= 1u << i;
+		t &= ~G_SIGNAL_TYPE_STATIC_SCOPE;
+		types[i] = t;
+		types[query->n_params + i] = G_TYPE_FUNDAMENTAL (t);
+	}
+
+	return signature;
+}
+
+/* call with the lock held. */
+static CacheEntry *
+lookup_query (GType instance_type, guint signal_id)
+{
+	CacheKey key = { instance_type, signal_id, 0, 0 };
+	CacheEntry * entry;
+	GSignalQuery query;
+
+	ensure_tables ();
+
+	entry = g_hash_table_lookup (queries, &key);
+	if (entry)
+		return entry;
+
+	g_signal_query (signal_id, &query);
+	if (!query.signal_id || !g_type_is_a (instance_type, query.itype))
+		return NULL;
+
+	entry = g_new0 (CacheEntry, 1);
+	entry->key = key;
+	entry->itype = query.itype;
+	entry->signature = signature_new (&query);
+	g_hash_table_insert (queries, &entry->key, entry);
+
+	return entry;
+}
+
+const GPerlSignalSignature *
+perl_signal_get_signature (GType instance_type, guint signal_id)
+{
+	CacheEntry * entry;
+
+	G_LOCK (signal_cache);
+	entry = lookup_query (instance_type, signal_id);
+	G_UNLOCK (signal_cache);
+
+	return entry ? entry->signature : NULL;
+}
+
+static gboolean
+involves_type (gpointer key, gpointer value, gpointer data)
+{
+	CacheEntry * entry = value;
+	GType type = GPOINTER_TO_SIZE (data);
+	return entry->key.type == type || entry->itype == type;
+}
+
+void
+perl_signal_cache_invalidate_type (GType type)
+{
+	G_LOCK (signal_cache);
+	if (queries) {
+		g_hash_table_foreach_remove (queries, involves_type,
+		                             GSIZE_TO_POINTER (type));
+		g_hash_table_foreach_remove (hints, involves_type,
+		                             GSIZE_TO_POINTER (type));
+	}
+	G_UNLOCK (signal_cache);
+}
+
+/*
+ * --- perl side ---------------------------------------------------------------
+ */
+
+static SV *
+frozen (SV * sv)
+{
+	SvREADONLY_on (sv);
+	return sv;
+}
+
+static SV *
+newSVtype (GType type)
+{
+	const char * package = perl_package_from_type (type);
+	if (!package)
+		package = g_type_name (type);
+	return frozen (newSVpv (package, 0));
+}
+
+/* the hash is locked, so every key a caller may look at has to be
+ * present; return_type is undef for signals that return nothing. */
+static HV *
+query_hv_new (const GPerlSignalSignature * signature)
+{
+	HV * hv;
+	AV * av;
+	guint i;
+
+	hv = newHV ();
+	perl_hv_take_sv_s (hv, "signal_id", frozen (newSVuv (signature->signal_id)));
+	perl_hv_take_sv_s (hv, "signal_name",
+	                    frozen (newSVpv (signature->signal_name, 0)));
+	perl_hv_take_sv_s (hv, "itype", newSVtype (signature->itype));
+	perl_hv_take_sv_s (hv, "signal_flags",
+	                    frozen (newSVGSignalFlags (signature->flags)));
+	perl_hv_take_sv_s (hv, "return_type",
+	                    signature->return_type != G_TYPE_NONE
+	                    ? newSVtype (signature->return_type)
+	                    : frozen (newSV (0)));
+
+	av = newAV ();
+	av_extend (av, signature->n_params);
+	for (i = 0 ; i < signature->n_params ; i++)
+		av_push (av, newSVtype (signature->param_types[i]));
+	SvREADONLY_on ((SV *) av);
+	/* n_params is inferred by the length of the av in param_types */
+	perl_hv_take_sv_s (hv, "param_types", frozen (newRV_noinc ((SV *) av)));
+
+	SvREADONLY_on ((SV *) hv);
+	return hv;
+}
+
+static HV *
+hint_hv_new (const GSignalInvocationHint * ihint)
+{
+	HV * hv = newHV ();
+	perl_hv_take_sv_s (hv, "signal_name",
+	                    frozen (newSVGChar (g_signal_name (ihint->signal_id))));
+	perl_hv_take_sv_s (hv, "detail",
+	                    frozen (newSVGChar (g_quark_to_string (ihint->detail))));
+	perl_hv_take_sv_s (hv, "run_type",
+	                    frozen (newSVGSignalFlags (ihint->run_type)));
+	SvREADONLY_on ((SV *) hv);
+	return hv;
+}
+
+static gboolean
+may_share (pTHX)
+{
+#ifdef PERL_IMPLICIT_CONTEXT
+	if (!owner)
+		owner = aTHX;
+	return owner == aTHX;
+#else
+	return TRUE;
+#endif
+}
+
+static void
+free_signature (pTHX_ void * signature)
+{
+	g_free (signature);
+}
+
+/* the hashes are built with the lock released, since building them calls
+ * into perl and a croak there must not leave the cache locked. */
+static HV *
+query_hv_build (pTHX_ const GSignalQuery * query)
+{
+	GPerlSignalSignature * signature = signature_new (query);
+	HV * hv;
+
+	ENTER;
+	SAVEDESTRUCTOR_X (free_signature, signature);
+	hv = query_hv_new (signature);
+	LEAVE;
+	return hv;
+}
+
+/* call with the lock held.  installs hv in entry unless another thread got
+ * there first, and returns a reference to whichever hash is cached; hv is
+ * consumed either way. */
+static SV *
+share_hv (pTHX_ CacheEntry * entry, HV * hv)
+{
+	SV * rv;
+
+	if (!entry)
+		return newRV_noinc ((SV *) hv);
+	if (entry->hv) {
+		rv = newRV_inc ((SV *) entry->hv);
+		release_hv (aTHX_ hv);
+		return rv;
+	}
+	entry->hv = hv;
+#ifdef PERL_IMPLICIT_CONTEXT
+	entry->perl = aTHX;
+#endif
+	return newRV_inc ((SV *) hv);
+}
+
+SV *
+newSVGSignalQuery (GSignalQuery * query)
+{
+	dTHX;
+	CacheEntry * entry;
+	HV * hv;
+	SV * rv;
+
+	if (!query || !query->signal_id)
+		return &PL_sv_undef;
+
+	G_LOCK (signal_cache);
+	if (!may_share (aTHX)) {
+		G_UNLOCK (signal_cache);
+		return newRV_noinc ((SV *) query_hv_build (aTHX_ query));
+	}
+	entry = lookup_query (query->itype, query->signal_id);
+	if (!entry) {
+		G_UNLOCK (signal_cache);
+		return &PL_sv_undef;
+	}
+	if (entry->hv) {
+		rv = newRV_inc ((SV *) entry->hv);
+		G_UNLOCK (signal_cache);
+		return rv;
+	}
+	G_UNLOCK (signal_cache);
+
+	hv = query_hv_build (aTHX_ query);
+
+	/* the entry may have been invalidated meanwhile, so look it up
+	 * again rather than keeping the old pointer. */
+	G_LOCK (signal_cache);
+	rv = share_hv (aTHX_ lookup_query (query->itype, query->signal_id), hv);
+	G_UNLOCK (signal_cache);
+
+	return rv;
+}
+
+SV *
+newSVGSignalInvocationHint (GSignalInvocationHint * ihint)
+{
+	dTHX;
+	CacheKey key = { 0, ihint->signal_id, ihint->detail, ihint->run_type };
+	CacheEntry * entry;
+	GSignalQuery query;
+	HV * hv;
+	SV * rv;
+
+	G_LOCK (signal_cache);
+	if (!may_share (aTHX)) {
+		G_UNLOCK (signal_cache);
+		return newRV_noinc ((SV *) hint_hv_new (ihint));
+	}
+	ensure_tables ();
+	entry = g_hash_table_lookup (hints, &key);
+	if (entry) {
+		rv = newRV_inc ((SV *) entry->hv);
+		G_UNLOCK (signal_cache);
+		return rv;
+	}
+	G_UNLOCK (signal_cache);
+
+	hv = hint_hv_new (ihint);
+	g_signal_query (ihint->signal_id, &query);
+
+	G_LOCK (signal_cache);
+	ensure_tables ();
+	entry = g_hash_table_lookup (hints, &key);
+	if (!entry) {
+		entry = g_new0 (CacheEntry, 1);
+		entry->key = key;
+		entry->itype = query.itype;
+		g_hash_table_insert (hints, &entry->key, entry);
+	}
+	rv = share_hv (aTHX_ entry, hv);
+	G_UNLOCK (signal_cache);
+
+	return rv;
+}
@@ -0,0 +1,479 @@
+/*
+ * UTF-8 validation and the char and filename converters; see gperl_utf8.h.
+ *
+ * the vector validator is the lookup-table scheme from simdjson (Keiser
+ * and Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte"):
+ * three 16 entry tables indexed by the nibbles of each byte and the byte
+ * before it flag every two-byte error pattern, and two saturating
+ * subtractions find the bytes that must be the third or fourth of a
+ * sequence.  a block is valid if and only if the combination is zero.
+ */
+
+#include <string.h>
+
+#include "gperl_utf8.h"
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+# define PERL_UTF8_HAVE_X86 1
+# include <immintrin.h>
+# define PERL_UTF8_AVX2	__attribute__ ((target ("avx2")))
+#endif
+
+/* strings shorter than this are rescanned every time; attaching magic
+ * would cost more than the scan. */
+#define PERL_UTF8_CACHE_MIN	256
+
+/*
+ * --- instruction set selection ----------------------------------------------
+ */
+
+#ifdef PERL_UTF8_HAVE_X86
+/* 0 means "not checked yet", 1 no, 2 yes. */
+static volatile gint have_avx2 = 0;
+
+static gboolean
+use_avx2 (void)
+{
+	gint avx2 = g_atomic_int_get (&have_avx2);
+	if (G_UNLIKELY (avx2 == 0)) {
+		__builtin_cpu_init ();
+		avx2 = __builtin_cpu_supports ("avx2") ? 2 : 1;
+		g_atomic_int_set (&have_avx2, avx2);
+	}
+	return avx2 == 2;
+}
+#endif
+
+/*
+ * --- ASCII runs -------------------------------------------------------------
+ */
+
+static gsize
+ascii_span_scalar (const guchar * s, gsize start, gsize len)
+{
+	gsize i = start;
+
+	for ( ; i + 8 <= len ; i += 8) {
+		guint64 word;
+		memcpy (&word, s + i, 8);
+		if (word & G_GUINT64_CONSTANT (0x8080808080808080))
+			break;
+	}
+	while (i < len && s[i] < 0x80)
+		i++;
+	return i;
+}
+
+#ifdef PERL_UTF8_HAVE_X86
+/* stops at the start of the first block holding a non-ASCII byte, or at
+ * the end of the last whole block. */
+PERL_UTF8_AVX2 static gsize
+ascii_span_avx2 (const guchar * s, gsize len)
+{
+	gsize i;
+
+	for (i = 0 ; i + 32 <= len ; i += 32) {
+		__m256i v = _mm256_loadu_si256 ((const __m256i *) (s + i));
+		if (_mm256_movemask_epi8 (v))
+			break;
+	}
+	return i;
+}
+#endif
+
+gsize
+perl_utf8_ascii_span (const char * str, gsize len)
+{
+	const guchar * s = (const guchar *) str;
+	gsize done = 0;
+#ifdef PERL_UTF8_HAVE_X86
+	if (use_avx2 ())
+		done = ascii_span_avx2 (s, len);
+#endif
+	return ascii_span_scalar (s, done, len);
+}
+
+/*
+ * --- validation -------------------------------------------------------------
+ */
+
+static gboolean
+validate_scalar (const guchar * s, gsize i, gsize len)
+{
+	while (i < len) {
+		guchar c = s[i], lo = 0x80, hi = 0xbf;
+		gsize n, k;
+
+		if (c < 0x80) {
+			i++;
+			continue;
+		}
+		if (c < 0xc2)
+			return FALSE;	/* continuation or overlong lead */
+		else if (c < 0xe0)
+			n = 1;
+		else if (c < 0xf0) {
+			n = 2;
+			if (c == 0xe0)
+				lo = 0xa0;	/* overlong */
+			else if (c == 0xed)
+				hi = 0x9f;	/* surrogates */
+		} else if (c < 0xf5) {
+			n = 3;
+			if (c == 0xf0)
+				lo = 0x90;	/* overlong */
+			else if (c == 0xf4)
+				hi = 0x8f;	/* above U+10FFFF */
+		} else
+			return FALSE;
+
+		if (len - i <= n || s[i + 1] < lo || s[i + 1] > hi)
+			return FALSE;
+		for (k = 2 ; k <= n ; k++)
+			if ((s[i + k] & 0xc0) != 0x80)
+				return FALSE;
+		i += n + 1;
+	}
+	return TRUE;
+}
+
+#ifdef PERL_UTF8_HAVE_X86
+
+enum {
+	TOO_SHORT      = 1 << 0,	/* lead byte not followed by a continuation */
+	TOO_LONG       = 1 << 1,	/* continuation after ASCII */
+	OVERLONG_3     = 1 << 2,
+	TOO_LARGE      = 1 << 3,
+	SURROGATE      = 1 << 4,
+	OVERLONG_2     = 1 << 5,
+	TOO_LARGE_1000 = 1 << 6,
+	OVERLONG_4     = 1 << 6,
+	TWO_CONTS      = 1 << 7,	/* continuation after continuation */
+	CARRY          = TOO_SHORT | TOO_LONG | TWO_CONTS
+};
+
+/* indexed by the high nibble of the previous byte */
+static const guint8 byte_1_high_table[16] = {
+	TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+	TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+	TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+	TOO_SHORT | OVERLONG_2,
+	TOO_SHORT,
+	TOO_SHORT | OVERLONG_3 | SURROGATE,
+	TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+};
+
+/* indexed by the low nibble of the previous byte */
+static const guint8 byte_1_low_table[16] = {
+	CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+	CARRY | OVERLONG_2,
+	CARRY,
+	CARRY,
+	CARRY | TOO_LARGE,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000
+};
+
+/* indexed by the high nibble of the current byte */
+static const guint8 byte_2_high_table[16] = {
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+};
+
+/* a block ending in one of these leaves a sequence open */
+static const guint8 incomplete_max[32] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xf0 - 1, 0xe0 - 1, 0xc0 - 1
+};
+
+/* the block shifted right by n bytes, filled from the end of prev */
+#define PREV_BYTES(input, prev, n)					\
+	_mm256_alignr_epi8 ((input),					\
+	                    _mm256_permute2x128_si256 ((prev), (input), 0x21),\
+	                    16 - (n))
+
+PERL_UTF8_AVX2 static __m256i
+table16 (const guint8 * table)
+{
+	return _mm256_broadcastsi128_si256 (
+		_mm_loadu_si128 ((const __m128i *) table));
+}
+
+PERL_UTF8_AVX2 static __m256i
+high_nibbles (__m256i v)
+{
+	return _mm256_and_si256 (_mm256_srli_epi16 (v, 4),
+	                         _mm256_set1_epi8 (0x0f));
+}
+
+PERL_UTF8_AVX2 static __m256i
+check_block (__m256i input, __m256i prev_input)
+{
+	__m256i prev1 = PREV_BYTES (input, prev_input, 1);
+	__m256i prev2 = PREV_BYTES (input, prev_input, 2);
+	__m256i prev3 = PREV_BYTES (input, prev_input, 3);
+	__m256i special, third, fourth, must23;
+
+	special = _mm256_and_si256 (
+		_mm256_and_si256 (
+			_mm256_shuffle_epi8 (table16 (byte_1_high_table),
+			                     high_nibbles (prev1)),
+			_mm256_shuffle_epi8 (table16 (byte_1_low_table),
+			                     _mm256_and_si256 (prev1,
+			                         _mm256_set1_epi8 (0x0f)))),
+		_mm256_shuffle_epi8 (table16 (byte_2_high_table),
+		                     high_nibbles (input)));
+
+	/* only bytes two or three after a 3 or 4 byte lead end up with
+	 * their top bit set here */
+	third = _mm256_subs_epu8 (prev2, _mm256_set1_epi8 (0xe0 - 0x80));
+	fourth = _mm256_subs_epu8 (prev3, _mm256_set1_epi8 (0xf0 - 0x80));
+	must23 = _mm256_and_si256 (_mm256_or_si256 (third, fourth),
+	                           _mm256_set1_epi8 ((char) 0x80));
+
+	/* such a byte is a continuation following a continuation, which
+	 * the tables flag as TWO_CONTS; the xor cancels exactly those */
+	return _mm256_xor_si256 (must23, special);
+}
+
+PERL_UTF8_AVX2 static gboolean
+validate_avx2 (const guchar * s, gsize start, gsize len)
+{
+	const __m256i max = _mm256_loadu_si256 ((const __m256i *) incomplete_max);
+	__m256i error = _mm256_setzero_si256 ();
+	__m256i prev_input = _mm256_setzero_si256 ();
+	__m256i prev_incomplete = _mm256_setzero_si256 ();
+	guchar tail[32];
+	gsize i;
+
+	for (i = start ; i < len ; i += 32) {
+		__m256i input;
+
+		if (i + 32 <= len)
+			input = _mm256_loadu_si256 ((const __m256i *) (s + i));
+		else {
+			/* NUL padding is ASCII, so it also exposes a
+			 * truncated final sequence */
+			memset (tail, 0, sizeof (tail));
+			memcpy (tail, s + i, len - i);
+			input = _mm256_loadu_si256 ((const __m256i *) tail);
+		}
+
+		if (!_mm256_movemask_epi8 (input)) {
+			error = _mm256_or_si256 (error, prev_incomplete);
+			prev_incomplete = _mm256_setzero_si256 ();
+		} else {
+			error = _mm256_or_si256 (error,
+			                         check_block (input, prev_input));
+			prev_incomplete = _mm256_subs_epu8 (input, max);
+		}
+		prev_input = input;
+	}
+	error = _mm256_or_si256 (error, prev_incomplete);
+
+	return _mm256_testz_si256 (error, error);
+}
+
+#endif /* PERL_UTF8_HAVE_X86 */
+
+gboolean
+perl_utf8_validate (const char * str, gsize len, gboolean * is_ascii)
+{
+	const guchar * s = (const guchar *) str;
+	gsize start = perl_utf8_ascii_span (str, len);
+
+	if (is_ascii)
+		*is_ascii = start == len;
+	if (start == len)
+		return TRUE;
+#ifdef PERL_UTF8_HAVE_X86
+	if (use_avx2 ())
+		return validate_avx2 (s, start, len);
+#endif
+	return validate_scalar (s, start, len);
+}
+
+/*
+ * --- validated-once cache ---------------------------------------------------
+ *
+ * ext magic whose set hook forgets the result, the same way perl keeps
+ * its own utf8 length cache honest.  mg_private is 1 while the string is
+ * known to be valid; mg_ptr remembers the buffer it was valid for, so a
+ * reallocation without set magic is caught too.
+ */
+
+static int
+utf8_cache_forget (pTHX_ SV * sv, MAGIC * mg)
+{
+	PERL_UNUSED_ARG (sv);
+	mg->mg_private = 0;
+	mg->mg_ptr = NULL;
+	return 0;
+}
+
+static MGVTBL utf8_cache_vtbl = { 0, utf8_cache_forget, 0, 0, 0, 0, 0, 0 };
+
+static gboolean
+cacheable (SV * sv, STRLEN len)
+{
+	/* temporaries go away or get reused before a second lookup */
+	return len >= PERL_UTF8_CACHE_MIN && !SvTEMP (sv) && !SvPADTMP (sv);
+}
+
+/* the UTF-8 form of sv, upgrading it in place like sv_utf8_upgrade. */
+static char *
+sv_to_utf8 (pTHX_ SV * sv, STRLEN * len)
+{
+	MAGIC * mg = NULL;
+	char * str;
+
+	SvGETMAGIC (sv);
+	str = SvPV_nomg (sv, *len);
+
+	if (!SvUTF8 (sv)) {
+		if (perl_utf8_ascii_span (str, *len) == *len) {
+			if (SvPOK (sv) && !SvREADONLY (sv))
+				SvUTF8_on (sv);
+			return str;
+		}
+		/* latin-1 in, so always valid out */
+		sv_utf8_upgrade_nomg (sv);
+		return SvPV_nomg (sv, *len);
+	}
+
+	if (cacheable (sv, *len) && SvMAGICAL (sv)) {
+		mg = mg_findext (sv, PERL_MAGIC_ext, &utf8_cache_vtbl);
+		if (mg && mg->mg_private && mg->mg_ptr == str)
+			return str;
+	}
+
+	/* perl strings may hold surrogates and code points beyond
+	 * U+10FFFF, GLib's may not */
+	if (!perl_utf8_validate (str, *len, NULL))
+		croak ("string is not valid UTF-8 and cannot be passed to GLib");
+
+	if (cacheable (sv, *len)) {
+		if (!mg)
+			mg = sv_magicext (sv, NULL, PERL_MAGIC_ext,
+			                  &utf8_cache_vtbl, NULL, 0);
+		mg->mg_private = 1;
+		mg->mg_ptr = str;
+	}
+	return str;
+}
+
+/*
+ * --- converters -------------------------------------------------------------
+ */
+
+char *
+SvGChar (SV * sv)
+{
+	dTHX;
+	STRLEN len;
+	return sv_to_utf8 (aTHX_ sv, &len);
+}
+
+SV *
+newSVGChar (const char * str)
+{
+	dTHX;
+	gsize len;
+	SV * sv;
+
+	if (!str)
+		return &PL_sv_undef;
+
+	len = strlen (str);
+	sv = newSVpvn (str, len);
+	if (perl_utf8_validate (str, len, NULL))
+		SvUTF8_on (sv);
+	else
+		warn ("newSVGChar: string is not valid UTF-8, "
+		      "returning its bytes unchanged");
+	return sv;
+}
+
+/* 0 means "not checked yet", 1 no, 2 yes. */
+static volatile gint filename_utf8 = 0;
+
+gboolean
+perl_filename_charset_is_utf8 (void)
+{
+	gint utf8 = g_atomic_int_get (&filename_utf8);
+	if (G_UNLIKELY (utf8 == 0)) {
+		utf8 = g_get_filename_charsets (NULL) ? 2 : 1;
+		g_atomic_int_set (&filename_utf8, utf8);
+	}
+	return utf8 == 2;
+}
+
+/*
+ * with a UTF-8 filename encoding the result points into sv's own buffer
+ * instead of a temporary copy.  embedded NULs still go the slow way, so
+ * that they croak with the same GConvertError as before.
+ */
+char *
+perl_filename_from_sv (SV * sv)
+{
+	dTHX;
+	GError * error = NULL;
+	STRLEN len;
+	gsize written;
+	char * utf8, * filename, * lname;
+
+	utf8 = sv_to_utf8 (aTHX_ sv, &len);
+	if (perl_filename_charset_is_utf8 () && !memchr (utf8, '\0', len))
+		return utf8;
+
+	filename = g_filename_from_utf8 (utf8, len, NULL, &written, &error);
+	if (!filename)
+		perl_croak_mirror (NULL, error);
+
+	lname = perl_alloc_temp (written + 1);
+	memcpy (lname, filename, written);
+	g_free (filename);
+	return lname;
+}
+
+SV *
+perl_sv_from_filename (const char * filename)
+{
+	dTHX;
+	GError * error = NULL;
+	gsize len = strlen (filename), written;
+	gchar * str;
+	SV * sv;
+
+	if (perl_filename_charset_is_utf8 ()
+	    && perl_utf8_validate (filename, len, NULL)) {
+		sv = newSVpvn (filename, len);
+		SvUTF8_on (sv);
+		return sv;
+	}
+
+	str = g_filename_to_utf8 (filename, len, NULL, &written, &error);
+	if (!str)
+		perl_croak_mirror (NULL, error);
+
+	sv = newSVpvn (str, written);
+	g_free (str);
+	SvUTF8_on (sv);
+	return sv;
+}
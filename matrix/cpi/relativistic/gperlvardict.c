@@ -0,0 +1,327 @@
+/*
+ * direct perl hash to "a{sv}" serializer; see gperl_vardict.h.
+ *
+ * the layout written here is GVariant's normal form:
+ *
+ *   v       child value, a zero byte, then the child's type string
+ *   {sv}    key and its nul, padding to 8, the v, then one framing offset
+ *           holding the end of the key
+ *   a{sv}   entries each aligned to 8, then one framing offset per entry
+ *           holding its end
+ *
+ * framing offsets are little-endian and 1, 2, 4 or 8 bytes wide,
+ * whichever is the smallest that can address the whole container
+ * including the offsets themselves.  everything else is in host order.
+ */
+
+#include <string.h>
+
+#include "gperl_vardict.h"
+
+#if GLIB_CHECK_VERSION (2, 24, 0)
+
+typedef struct _Dict Dict;
+
+typedef enum {
+	VALUE_INT64,
+	VALUE_UINT64,
+	VALUE_DOUBLE,
+	VALUE_STRING,
+	VALUE_VARIANT,
+	VALUE_DICT
+} ValueKind;
+
+typedef struct {
+	const char * key;
+	STRLEN       key_len;
+	ValueKind    kind;
+	union {
+		gint64     i;
+		guint64    u;
+		gdouble    d;
+		struct {
+			const char * str;
+			STRLEN       len;
+		}          s;
+		GVariant * variant;	/* a reference, in normal form */
+		Dict     * dict;
+	} value;
+	gsize        child_size;
+	gsize        size;	/* the whole entry, framing included */
+} Entry;
+
+struct _Dict {
+	guint   n_entries;
+	Entry * entries;
+	gsize   size;
+};
+
+/* state for one serialization.  the variant references live here rather
+ * than in the entries so that a croak halfway through planning, which
+ * leaves the entries half filled in, still drops every one of them. */
+typedef struct {
+	GPtrArray * variants;	/* GVariant, referenced */
+	GPtrArray * path;	/* HV, the hashes being planned, outermost
+				 * first */
+} Plan;
+
+/* as deep as GVariant itself goes */
+#define MAX_DEPTH	128
+
+#define ALIGN8(n)	(((n) + 7) & ~(gsize) 7)
+
+static gsize
+framed_size (gsize body, gsize n_offsets)
+{
+	if (body + n_offsets <= G_MAXUINT8)
+		return body + n_offsets;
+	if (body + 2 * n_offsets <= G_MAXUINT16)
+		return body + 2 * n_offsets;
+	if (body + 4 * n_offsets <= G_MAXUINT32)
+		return body + 4 * n_offsets;
+	return body + 8 * n_offsets;
+}
+
+static guint
+offset_size (gsize container_size)
+{
+	if (container_size > G_MAXUINT32)
+		return 8;
+	if (container_size > G_MAXUINT16)
+		return 4;
+	if (container_size > G_MAXUINT8)
+		return 2;
+	return container_size > 0 ? 1 : 0;
+}
+
+static const char *
+type_string (const Entry * entry, gsize * len)
+{
+	switch (entry->kind) {
+	    case VALUE_INT64:	*len = 1; return "x";
+	    case VALUE_UINT64:	*len = 1; return "t";
+	    case VALUE_DOUBLE:	*len = 1; return "d";
+	    case VALUE_STRING:	*len = 1; return "s";
+	    case VALUE_DICT:	*len = 5; return "a{sv}";
+	    case VALUE_VARIANT:
+		*len = strlen (g_variant_get_type_string (entry->value.variant));
+		return g_variant_get_type_string (entry->value.variant);
+	}
+	g_assert_not_reached ();
+	return NULL;
+}
+
+static const char *
+utf8_string (pTHX_ SV * sv, STRLEN * len, const char * what, const char * key)
+{
+	const char * str = SvPVutf8 (sv, *len);
+	if (memchr (str, '\0', *len))
+		croak ("%s%s%s contains a NUL character and cannot be "
+		       "serialized", what, key ? " " : "", key ? key : "");
+	return str;
+}
+
+/*
+ * --- pass one: classify and size --------------------------------------------
+ */
+
+static Dict * plan_dict (pTHX_ Plan * plan, HV * hv);
+
+static void
+plan_value (pTHX_ Plan * plan, Entry * entry, SV * sv)
+{
+	gsize type_len;
+
+	SvGETMAGIC (sv);
+
+	if (SvROK (sv) && sv_derived_from (sv, "Glib::Variant")) {
+		GVariant * variant = SvGVariant (sv);
+		entry->kind = VALUE_VARIANT;
+		entry->value.variant = g_variant_get_normal_form (variant);
+		g_ptr_array_add (plan->variants, entry->value.variant);
+		entry->child_size = g_variant_get_size (entry->value.variant);
+
+	} else if (SvROK (sv) && SvTYPE (SvRV (sv)) == SVt_PVHV
+	           && !SvOBJECT (SvRV (sv))) {
+		entry->kind = VALUE_DICT;
+		entry->value.dict = plan_dict (aTHX_ plan, (HV *) SvRV (sv));
+		entry->child_size = entry->value.dict->size;
+
+	} else if (!SvOK (sv) || SvROK (sv)) {
+		croak ("value for key %s cannot be serialized into a{sv}",
+		       entry->key);
+
+	} else if (SvIOK (sv) && !SvPOK (sv)) {
+		if (SvIsUV (sv)) {
+			entry->kind = VALUE_UINT64;
+			entry->value.u = SvUVX (sv);
+		} else {
+			entry->kind = VALUE_INT64;
+			entry->value.i = SvIVX (sv);
+		}
+		entry->child_size = 8;
+
+	} else if (SvNOK (sv) && !SvPOK (sv)) {
+		entry->kind = VALUE_DOUBLE;
+		entry->value.d = SvNVX (sv);
+		entry->child_size = 8;
+
+	} else {
+		entry->kind = VALUE_STRING;
+		entry->value.s.str = utf8_string (aTHX_ sv, &entry->value.s.len,
+		                                  "value for key", entry->key);
+		entry->child_size = entry->value.s.len + 1;
+	}
+
+	type_string (entry, &type_len);
+	entry->size = framed_size (ALIGN8 (entry->key_len + 1)
+	                           + entry->child_size + 1 + type_len, 1);
+}
+
+static Dict *
+plan_dict (pTHX_ Plan * plan, HV * hv)
+{
+	Dict * dict;
+	gsize body = 0;
+	HE * he;
+	guint i;
+
+	for (i = 0 ; i < plan->path->len ; i++)
+		if (g_ptr_array_index (plan->path, i) == hv)
+			croak ("hash refers to itself and cannot be serialized "
+			       "into a{sv}");
+	if (plan->path->len >= MAX_DEPTH)
+		croak ("hashes nested more than %d deep cannot be serialized "
+		       "into a{sv}", MAX_DEPTH);
+	g_ptr_array_add (plan->path, hv);
+
+	dict = perl_alloc_temp (sizeof (Dict));
+	i = 0;
+
+	dict->n_entries = hv_iterinit (hv);
+	dict->entries = perl_alloc_temp (MAX (dict->n_entries, 1)
+	                                  * sizeof (Entry));
+
+	while (i < dict->n_entries && (he = hv_iternext (hv))) {
+		Entry * entry = &dict->entries[i++];
+		entry->key = utf8_string (aTHX_ hv_iterkeysv (he),
+		                          &entry->key_len, "key", NULL);
+		plan_value (aTHX_ plan, entry, hv_iterval (hv, he));
+		body = ALIGN8 (body) + entry->size;
+	}
+	dict->n_entries = i;
+	dict->size = framed_size (body, dict->n_entries);
+
+	g_ptr_array_set_size (plan->path, plan->path->len - 1);
+
+	return dict;
+}
+
+/*
+ * --- pass two: write --------------------------------------------------------
+ */
+
+static void
+write_offset (guchar * dest, gsize value, guint size)
+{
+	guint i;
+	for (i = 0 ; i < size ; i++, value >>= 8)
+		dest[i] = value & 0xff;
+}
+
+static void write_dict (const Dict * dict, guchar * dest);
+
+static void
+write_entry (Entry * entry, guchar * dest)
+{
+	gsize pos, type_len;
+	const char * type;
+
+	memcpy (dest, entry->key, entry->key_len);
+	dest[entry->key_len] = '\0';
+	pos = ALIGN8 (entry->key_len + 1);
+
+	switch (entry->kind) {
+	    case VALUE_INT64:
+		memcpy (dest + pos, &entry->value.i, 8);
+		break;
+	    case VALUE_UINT64:
+		memcpy (dest + pos, &entry->value.u, 8);
+		break;
+	    case VALUE_DOUBLE:
+		memcpy (dest + pos, &entry->value.d, 8);
+		break;
+	    case VALUE_STRING:
+		memcpy (dest + pos, entry->value.s.str, entry->value.s.len);
+		dest[pos + entry->value.s.len] = '\0';
+		break;
+	    case VALUE_VARIANT:
+		g_variant_store (entry->value.variant, dest + pos);
+		break;
+	    case VALUE_DICT:
+		write_dict (entry->value.dict, dest + pos);
+		break;
+	}
+	pos += entry->child_size;
+
+	dest[pos++] = '\0';
+	type = type_string (entry, &type_len);
+	memcpy (dest + pos, type, type_len);
+
+	write_offset (dest + entry->size - offset_size (entry->size),
+	              entry->key_len + 1, offset_size (entry->size));
+}
+
+static void
+write_dict (const Dict * dict, guchar * dest)
+{
+	guint osize = offset_size (dict->size);
+	guchar * offsets = dest + dict->size - osize * dict->n_entries;
+	gsize pos = 0;
+	guint i;
+
+	for (i = 0 ; i < dict->n_entries ; i++) {
+		pos = ALIGN8 (pos);
+		write_entry (&dict->entries[i], dest + pos);
+		pos += dict->entries[i].size;
+		write_offset (offsets + i * osize, pos, osize);
+	}
+}
+
+static void
+plan_free (pTHX_ void * data)
+{
+	Plan * plan = data;
+	g_ptr_array_free (plan->variants, TRUE);
+	g_ptr_array_free (plan->path, TRUE);
+	g_free (plan);
+}
+
+GVariant *
+perl_vardict_from_hv (HV * hv)
+{
+	dTHX;
+	Plan * plan;
+	Dict * dict;
+	guchar * data;
+	gsize size;
+
+	plan = g_new (Plan, 1);
+	plan->variants = g_ptr_array_new_with_free_func (
+	                        (GDestroyNotify) g_variant_unref);
+	plan->path = g_ptr_array_new ();
+
+	ENTER;
+	SAVEDESTRUCTOR_X (plan_free, plan);
+	dict = plan_dict (aTHX_ plan, hv);
+	/* zeroed, so the alignment padding is already in normal form */
+	size = dict->size;
+	data = g_malloc0 (MAX (size, 1));
+	write_dict (dict, data);
+	LEAVE;
+
+	return g_variant_new_from_data (G_VARIANT_TYPE_VARDICT, data,
+	                                size, TRUE, g_free, data);
+}
+
+#endif /* 2.24.0 */
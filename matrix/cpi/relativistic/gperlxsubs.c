@@ -0,0 +1,670 @@
+/*
+ * binary XSUB index; see gperl_xsubs.h.
+ *
+ * file layout, all integers in host order:
+ *
+ *   header        magic, byte order mark, version, counts, section offsets
+ *   strings       interned NUL-terminated names and prototypes
+ *   packages      guint32 string offset of each package name, sorted
+ *   prototypes    guint32 string offset of each distinct prototype
+ *   displacements gint32 per hash bucket, n_subs of them
+ *   entries       8 bytes per sub in slot order: the string offset of its
+ *                 name, and its package and prototype as table indices
+ *
+ * the perfect hash is "hash and displace": a key's bucket is h(0, key) mod
+ * n.  a bucket holding several keys stores the seed d > 0 that scatters
+ * them into free slots h(d, key) mod n; a bucket holding one key stores
+ * the slot itself as -(slot + 1).  a lookup therefore finds the only slot
+ * the key could be in and compares names once to reject unknown keys.
+ */
+
+#include <string.h>
+
+#include "gperl_xsubs.h"
+
+#define INDEX_MAGIC		"GPXSUBI1"
+#define INDEX_BYTE_ORDER	0x01020304u
+#define INDEX_VERSION		1u
+#define NO_PROTOTYPE		G_MAXUINT16
+
+typedef struct {
+	gchar   magic[8];
+	guint32 byte_order;
+	guint32 version;
+	guint32 n_subs;
+	guint32 n_packages;
+	guint32 n_prototypes;
+	guint32 strings_offset;
+	guint32 strings_size;
+	guint32 packages_offset;
+	guint32 prototypes_offset;
+	guint32 displacements_offset;
+	guint32 entries_offset;
+} IndexHeader;
+
+typedef struct {
+	guint32 name;
+	guint16 package;
+	guint16 prototype;
+} IndexEntry;
+
+struct _GPerlXSubIndex {
+	GMappedFile       * file;
+	const IndexHeader * header;
+	const gchar       * strings;
+	const guint32     * packages;
+	const guint32     * prototypes;
+	const gint32      * displacements;
+	const IndexEntry  * entries;
+};
+
+/*
+ * --- hashing ----------------------------------------------------------------
+ *
+ * FNV-1a over "Package::sub", streamed so the two halves never need to be
+ * joined, with the seed folded into the offset basis and a murmur3
+ * finalizer on top so consecutive seeds give unrelated slots.
+ */
+
+static inline guint32
+hash_bytes (guint32 h, const gchar * s, gsize len)
+{
+	gsize i;
+	for (i = 0 ; i < len ; i++)
+		h = (h ^ (guchar) s[i]) * 0x01000193u;
+	return h;
+}
+
+static inline guint32
+hash_start (guint32 seed)
+{
+	return 0x811c9dc5u ^ (seed * 0x9e3779b9u);
+}
+
+static inline guint32
+hash_finish (guint32 h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h;
+}
+
+static guint32
+hash_sub (guint32 seed, const gchar * package, const gchar * sub)
+{
+	guint32 h = hash_start (seed);
+	h = hash_bytes (h, package, strlen (package));
+	h = hash_bytes (h, "::", 2);
+	h = hash_bytes (h, sub, strlen (sub));
+	return hash_finish (h);
+}
+
+static guint32
+hash_name (guint32 seed, const gchar * full_name)
+{
+	return hash_finish (hash_bytes (hash_start (seed),
+	                                full_name, strlen (full_name)));
+}
+
+/*
+ * --- compiling --------------------------------------------------------------
+ */
+
+typedef struct {
+	const gchar * package;	/* all three from g_intern_string */
+	const gchar * name;
+	const gchar * prototype;
+} SubDecl;
+
+typedef struct {
+	GString    * pool;
+	GHashTable * offsets;	/* string -> offset in pool + 1 */
+	GHashTable * seen;	/* "Package::sub" */
+	GHashTable * packages;	/* package -> index + 1, once numbered */
+	GHashTable * prototypes;	/* prototype -> index + 1 */
+	GPtrArray  * prototype_list;
+	GArray     * subs;	/* SubDecl */
+} Compiler;
+
+static guint32
+intern (Compiler * c, const gchar * str)
+{
+	gpointer offset = g_hash_table_lookup (c->offsets, str);
+	if (!offset) {
+		offset = GUINT_TO_POINTER (c->pool->len + 1);
+		g_string_append_len (c->pool, str, strlen (str) + 1);
+		g_hash_table_insert (c->offsets, g_strdup (str), offset);
+	}
+	return GPOINTER_TO_UINT (offset) - 1;
+}
+
+static const gchar *
+take_word (gchar ** p, const gchar * stops)
+{
+	gchar * start = *p, * end = start;
+	gchar saved;
+	const gchar * word;
+
+	while (*end && !g_ascii_isspace (*end) && !strchr (stops, *end))
+		end++;
+	if (end == start)
+		return NULL;
+	*p = end;
+	saved = *end;
+	*end = '\0';
+	word = g_intern_string (start);
+	*end = saved;
+	return word;
+}
+
+static gboolean
+parse_source (Compiler * c, gchar * text, GError ** error)
+{
+	const gchar * package = "main";
+	gchar * line, * next;
+	guint lineno = 0;
+
+	for (line = text ; line ; line = next) {
+		gchar * p;
+
+		next = strchr (line, '\n');
+		if (next)
+			*next++ = '\0';
+		lineno++;
+
+		p = g_strchug (line);
+		if (!*p || *p == '#')
+			continue;
+
+		if (g_str_has_prefix (p, "package ")) {
+			p += 8;
+			while (g_ascii_isspace (*p))
+				p++;
+			package = take_word (&p, "{;");
+			if (!package) {
+				g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+				             "line %u: package without a name", lineno);
+				return FALSE;
+			}
+			g_hash_table_replace (c->packages, (gpointer) package,
+			                      (gpointer) package);
+
+		} else if (g_str_has_prefix (p, "sub ")) {
+			SubDecl decl;
+			gchar * full;
+
+			p += 4;
+			while (g_ascii_isspace (*p))
+				p++;
+			decl.package = package;
+			decl.name = take_word (&p, "(;");
+			decl.prototype = NULL;
+			if (!decl.name) {
+				g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+				             "line %u: sub without a name", lineno);
+				return FALSE;
+			}
+			while (g_ascii_isspace (*p))
+				p++;
+			if (*p == '(') {
+				gchar * close = strchr (p, ')');
+				if (!close) {
+					g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+					             "line %u: unterminated prototype", lineno);
+					return FALSE;
+				}
+				*close = '\0';
+				decl.prototype = g_intern_string (p + 1);
+				if (!g_hash_table_lookup (c->prototypes, decl.prototype)) {
+					g_ptr_array_add (c->prototype_list,
+					                 (gpointer) decl.prototype);
+					g_hash_table_insert (c->prototypes,
+					                     (gpointer) decl.prototype,
+					                     GUINT_TO_POINTER (c->prototype_list->len));
+				}
+			}
+
+			/* the listing is generated per module, so a sub can turn
+			 * up twice; the first declaration wins. */
+			full = g_strconcat (decl.package, "::", decl.name, NULL);
+			if (g_hash_table_lookup (c->seen, full)) {
+				g_free (full);
+				continue;
+			}
+			g_hash_table_insert (c->seen, full, full);
+			g_array_append_val (c->subs, decl);
+
+		} else if (*p == '}') {
+			package = "main";
+		}
+	}
+
+	return TRUE;
+}
+
+static gint
+compare_buckets_by_size (gconstpointer a, gconstpointer b)
+{
+	const GArray * x = *(GArray * const *) a;
+	const GArray * y = *(GArray * const *) b;
+	return (gint) y->len - (gint) x->len;
+}
+
+/* fill slot_of (slot -> sub) and displacements (bucket -> seed or slot). */
+static void
+build_perfect_hash (const GArray * subs, gint32 * slot_of, gint32 * displacements)
+{
+	guint n = subs->len, b, i;
+	GArray ** buckets = g_new (GArray *, n);
+	GPtrArray * order = g_ptr_array_sized_new (n);
+	guint32 * slots = g_new (guint32, n);
+	guint next_free = 0;
+
+	for (b = 0 ; b < n ; b++) {
+		buckets[b] = g_array_new (FALSE, FALSE, sizeof (guint));
+		g_ptr_array_add (order, buckets[b]);
+		slot_of[b] = -1;
+		displacements[b] = 0;
+	}
+	for (i = 0 ; i < n ; i++) {
+		const SubDecl * s = &g_array_index (subs, SubDecl, i);
+		g_array_append_val (buckets[hash_sub (0, s->package, s->name) % n], i);
+	}
+
+	/* place the crowded buckets first, while there is room. */
+	g_ptr_array_sort (order, compare_buckets_by_size);
+	for (b = 0 ; b < n ; b++) {
+		GArray * bucket = g_ptr_array_index (order, b);
+		const SubDecl * first;
+		guint32 d;
+
+		if (bucket->len < 2)
+			break;
+		for (d = 1 ; ; d++) {
+			guint k, placed = 0;
+			for (k = 0 ; k < bucket->len ; k++) {
+				const SubDecl * s = &g_array_index (subs, SubDecl,
+				        g_array_index (bucket, guint, k));
+				guint32 slot = hash_sub (d, s->package, s->name) % n;
+				guint m;
+				if (slot_of[slot] >= 0)
+					break;
+				for (m = 0 ; m < k ; m++)
+					if (slots[m] == slot)
+						break;
+				if (m < k)
+					break;
+				slots[k] = slot;
+				placed++;
+			}
+			if (placed == bucket->len)
+				break;
+		}
+		for (i = 0 ; i < bucket->len ; i++)
+			slot_of[slots[i]] = (gint32) g_array_index (bucket, guint, i);
+		first = &g_array_index (subs, SubDecl, g_array_index (bucket, guint, 0));
+		displacements[hash_sub (0, first->package, first->name) % n] = (gint32) d;
+	}
+
+	/* singletons go straight into whatever slots are left. */
+	for ( ; b < n ; b++) {
+		GArray * bucket = g_ptr_array_index (order, b);
+		const SubDecl * s;
+		if (bucket->len == 0)
+			break;
+		while (slot_of[next_free] >= 0)
+			next_free++;
+		i = g_array_index (bucket, guint, 0);
+		s = &g_array_index (subs, SubDecl, i);
+		slot_of[next_free] = (gint32) i;
+		displacements[hash_sub (0, s->package, s->name) % n] = -(gint32) next_free - 1;
+	}
+
+	for (b = 0 ; b < n ; b++)
+		g_array_free (buckets[b], TRUE);
+	g_free (buckets);
+	g_ptr_array_free (order, TRUE);
+	g_free (slots);
+}
+
+static gint
+compare_strings (gconstpointer a, gconstpointer b)
+{
+	return strcmp (*(const gchar * const *) a, *(const gchar * const *) b);
+}
+
+static void
+pad4 (GString * out)
+{
+	while (out->len % 4)
+		g_string_append_c (out, '\0');
+}
+
+gboolean
+perl_xsub_index_compile (const char  * source,
+                          const char  * output,
+                          GError     ** error)
+{
+	Compiler c;
+	IndexHeader header;
+	GString * out;
+	GPtrArray * packages;
+	GHashTableIter iter;
+	gpointer key;
+	gint32 * slot_of, * displacements;
+	gchar * text;
+	guint i;
+	gboolean ok = FALSE;
+
+	if (!g_file_get_contents (source, &text, NULL, error))
+		return FALSE;
+
+	c.pool = g_string_new (NULL);
+	c.offsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	c.seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	c.packages = g_hash_table_new (g_str_hash, g_str_equal);
+	c.prototypes = g_hash_table_new (g_str_hash, g_str_equal);
+	c.prototype_list = g_ptr_array_new ();
+	c.subs = g_array_new (FALSE, FALSE, sizeof (SubDecl));
+
+	if (!parse_source (&c, text, error))
+		goto out;
+	if (c.subs->len == 0) {
+		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+		             "%s declares no subs", source);
+		goto out;
+	}
+	if (g_hash_table_size (c.packages) > G_MAXUINT16 ||
+	    c.prototype_list->len >= NO_PROTOTYPE) {
+		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+		             "%s has too many packages or prototypes for the "
+		             "index format", source);
+		goto out;
+	}
+
+	slot_of = g_new (gint32, c.subs->len);
+	displacements = g_new (gint32, c.subs->len);
+	build_perfect_hash (c.subs, slot_of, displacements);
+
+	/* intern everything before laying out the file, so the pool's size is
+	 * known when the header is written. */
+	packages = g_ptr_array_new ();
+	g_hash_table_iter_init (&iter, c.packages);
+	while (g_hash_table_iter_next (&iter, &key, NULL))
+		g_ptr_array_add (packages, key);
+	g_ptr_array_sort (packages, compare_strings);
+	for (i = 0 ; i < packages->len ; i++) {
+		gpointer package = g_ptr_array_index (packages, i);
+		intern (&c, package);
+		g_hash_table_replace (c.packages, package, GUINT_TO_POINTER (i + 1));
+	}
+	for (i = 0 ; i < c.prototype_list->len ; i++)
+		intern (&c, g_ptr_array_index (c.prototype_list, i));
+	for (i = 0 ; i < c.subs->len ; i++)
+		intern (&c, g_array_index (c.subs, SubDecl, i).name);
+
+	memset (&header, 0, sizeof (header));
+	memcpy (header.magic, INDEX_MAGIC, sizeof (header.magic));
+	header.byte_order = INDEX_BYTE_ORDER;
+	header.version = INDEX_VERSION;
+	header.n_subs = c.subs->len;
+	header.n_packages = packages->len;
+	header.n_prototypes = c.prototype_list->len;
+
+	out = g_string_sized_new (sizeof (header) + c.pool->len
+	                          + 4 * (packages->len + c.prototype_list->len)
+	                          + (4 + sizeof (IndexEntry)) * c.subs->len);
+	g_string_append_len (out, (const gchar *) &header, sizeof (header));
+
+	header.strings_offset = out->len;
+	header.strings_size = c.pool->len;
+	g_string_append_len (out, c.pool->str, c.pool->len);
+	pad4 (out);
+
+	header.packages_offset = out->len;
+	for (i = 0 ; i < packages->len ; i++) {
+		guint32 offset = intern (&c, g_ptr_array_index (packages, i));
+		g_string_append_len (out, (const gchar *) &offset, 4);
+	}
+
+	header.prototypes_offset = out->len;
+	for (i = 0 ; i < c.prototype_list->len ; i++) {
+		guint32 offset = intern (&c, g_ptr_array_index (c.prototype_list, i));
+		g_string_append_len (out, (const gchar *) &offset, 4);
+	}
+
+	header.displacements_offset = out->len;
+	g_string_append_len (out, (const gchar *) displacements,
+	                     4 * c.subs->len);
+
+	header.entries_offset = out->len;
+	for (i = 0 ; i < c.subs->len ; i++) {
+		const SubDecl * s = &g_array_index (c.subs, SubDecl, slot_of[i]);
+		IndexEntry e;
+		e.name = intern (&c, s->name);
+		e.package = GPOINTER_TO_UINT (g_hash_table_lookup (c.packages, s->package)) - 1;
+		e.prototype = s->prototype
+		            ? GPOINTER_TO_UINT (g_hash_table_lookup (c.prototypes, s->prototype)) - 1
+		            : NO_PROTOTYPE;
+		g_string_append_len (out, (const gchar *) &e, sizeof (e));
+	}
+
+	memcpy (out->str, &header, sizeof (header));
+	ok = g_file_set_contents (output, out->str, out->len, error);
+
+	g_string_free (out, TRUE);
+	g_ptr_array_free (packages, TRUE);
+	g_free (slot_of);
+	g_free (displacements);
+    out:
+	g_free (text);
+	g_string_free (c.pool, TRUE);
+	g_hash_table_destroy (c.offsets);
+	g_hash_table_destroy (c.seen);
+	g_hash_table_destroy (c.packages);
+	g_hash_table_destroy (c.prototypes);
+	g_ptr_array_free (c.prototype_list, TRUE);
+	g_array_free (c.subs, TRUE);
+	return ok;
+}
+
+/*
+ * --- reading ----------------------------------------------------------------
+ */
+
+static gboolean
+section_ok (gsize file_size, guint32 offset, guint64 size)
+{
+	return offset % 4 == 0 && offset <= file_size && size <= file_size - offset;
+}
+
+static gboolean
+index_is_consistent (const GPerlXSubIndex * index, gsize size)
+{
+	const IndexHeader * h = index->header;
+	guint32 i;
+
+	if (size < sizeof (IndexHeader) ||
+	    memcmp (h->magic, INDEX_MAGIC, sizeof (h->magic)) != 0 ||
+	    h->byte_order != INDEX_BYTE_ORDER ||
+	    h->version != INDEX_VERSION ||
+	    h->n_subs == 0 ||
+	    !section_ok (size, h->strings_offset, h->strings_size) ||
+	    h->n_packages == 0 ||
+	    !section_ok (size, h->packages_offset, 4 * (guint64) h->n_packages) ||
+	    !section_ok (size, h->prototypes_offset, 4 * (guint64) h->n_prototypes) ||
+	    !section_ok (size, h->displacements_offset, 4 * (guint64) h->n_subs) ||
+	    !section_ok (size, h->entries_offset,
+	                 sizeof (IndexEntry) * (guint64) h->n_subs))
+		return FALSE;
+
+	/* with a NUL at the very end, every offset inside the pool is a
+	 * terminated string. */
+	if (h->strings_size == 0 || index->strings[h->strings_size - 1] != '\0')
+		return FALSE;
+	for (i = 0 ; i < h->n_packages ; i++)
+		if (index->packages[i] >= h->strings_size)
+			return FALSE;
+	for (i = 0 ; i < h->n_prototypes ; i++)
+		if (index->prototypes[i] >= h->strings_size)
+			return FALSE;
+	for (i = 0 ; i < h->n_subs ; i++) {
+		const IndexEntry * e = &index->entries[i];
+		if (e->name >= h->strings_size || e->package >= h->n_packages ||
+		    (e->prototype != NO_PROTOTYPE && e->prototype >= h->n_prototypes))
+			return FALSE;
+		if (index->displacements[i] < -(gint64) h->n_subs)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+GPerlXSubIndex *
+perl_xsub_index_open (const char * filename, GError ** error)
+{
+	GPerlXSubIndex * index;
+	const gchar * base;
+	gsize size;
+	GMappedFile * file;
+
+	file = g_mapped_file_new (filename, FALSE, error);
+	if (!file)
+		return NULL;
+
+	base = g_mapped_file_get_contents (file);
+	size = g_mapped_file_get_length (file);
+
+	index = g_new0 (GPerlXSubIndex, 1);
+	index->file = file;
+	index->header = (const IndexHeader *) base;
+	if (size >= sizeof (IndexHeader)) {
+		index->strings = base + index->header->strings_offset;
+		index->packages = (const guint32 *) (base + index->header->packages_offset);
+		index->prototypes = (const guint32 *) (base + index->header->prototypes_offset);
+		index->displacements = (const gint32 *) (base + index->header->displacements_offset);
+		index->entries = (const IndexEntry *) (base + index->header->entries_offset);
+	}
+
+	if (!index_is_consistent (index, size)) {
+		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+		             "%s is not a valid XSUB index for this host", filename);
+		perl_xsub_index_close (index);
+		return NULL;
+	}
+
+	return index;
+}
+
+void
+perl_xsub_index_close (GPerlXSubIndex * index)
+{
+	if (!index)
+		return;
+	g_mapped_file_unref (index->file);
+	g_free (index);
+}
+
+static const IndexEntry *
+entry_for_hash (const GPerlXSubIndex * index, guint32 h0, guint32 (*rehash) (guint32, gconstpointer), gconstpointer key)
+{
+	guint32 n = index->header->n_subs;
+	gint32 d = index->displacements[h0 % n];
+	guint32 slot = d < 0 ? (guint32) (-(d + 1)) : rehash ((guint32) d, key) % n;
+	return &index->entries[slot];
+}
+
+typedef struct {
+	const gchar * package;
+	const gchar * sub;
+} SplitKey;
+
+static guint32
+rehash_split (guint32 seed, gconstpointer key)
+{
+	const SplitKey * k = key;
+	return hash_sub (seed, k->package, k->sub);
+}
+
+static guint32
+rehash_name (guint32 seed, gconstpointer key)
+{
+	return hash_name (seed, key);
+}
+
+static gboolean
+found (const GPerlXSubIndex * index, const IndexEntry * e, const char ** prototype)
+{
+	if (prototype)
+		*prototype = e->prototype == NO_PROTOTYPE
+		           ? NULL : index->strings + index->prototypes[e->prototype];
+	return TRUE;
+}
+
+gboolean
+perl_xsub_index_lookup (const GPerlXSubIndex  * index,
+                         const char            * package,
+                         const char            * sub,
+                         const char           ** prototype)
+{
+	SplitKey key;
+	const IndexEntry * e;
+
+	g_return_val_if_fail (index != NULL, FALSE);
+	g_return_val_if_fail (package != NULL && sub != NULL, FALSE);
+
+	key.package = package;
+	key.sub = sub;
+	e = entry_for_hash (index, hash_sub (0, package, sub), rehash_split, &key);
+	if (strcmp (index->strings + e->name, sub) != 0 ||
+	    strcmp (index->strings + index->packages[e->package], package) != 0)
+		return FALSE;
+	return found (index, e, prototype);
+}
+
+gboolean
+perl_xsub_index_lookup_name (const GPerlXSubIndex  * index,
+                              const char            * full_name,
+                              const char           ** prototype)
+{
+	const IndexEntry * e;
+	const gchar * package, * sub;
+	gsize package_len;
+
+	g_return_val_if_fail (index != NULL, FALSE);
+	g_return_val_if_fail (full_name != NULL, FALSE);
+
+	e = entry_for_hash (index, hash_name (0, full_name), rehash_name, full_name);
+	package = index->strings + index->packages[e->package];
+	sub = index->strings + e->name;
+	package_len = strlen (package);
+	if (strncmp (full_name, package, package_len) != 0 ||
+	    full_name[package_len] != ':' || full_name[package_len + 1] != ':' ||
+	    strcmp (full_name + package_len + 2, sub) != 0)
+		return FALSE;
+	return found (index, e, prototype);
+}
+
+guint
+perl_xsub_index_get_n_subs (const GPerlXSubIndex * index)
+{
+	g_return_val_if_fail (index != NULL, 0);
+	return index->header->n_subs;
+}
+
+guint
+perl_xsub_index_get_n_packages (const GPerlXSubIndex * index)
+{
+	g_return_val_if_fail (index != NULL, 0);
+	return index->header->n_packages;
+}
+
+const char *
+perl_xsub_index_get_package (const GPerlXSubIndex * index, guint i)
+{
+	g_return_val_if_fail (index != NULL, NULL);
+	g_return_val_if_fail (i < index->header->n_packages, NULL);
+	return index->strings + index->packages[i];
+}
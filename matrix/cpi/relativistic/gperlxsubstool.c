@@ -0,0 +1,76 @@
+/*
+ * command line front end for the XSUB index.
+ *
+ *   gperlxsubs compile _Deparsed_XSubs.pm xsubs.idx
+ *   gperlxsubs query xsubs.idx Package::sub ...
+ *
+ * query prints each name with its prototype in parentheses, or "(none)"
+ * for a sub declared without one, and exits 1 if any name is not an XSUB.
+ */
+
+#include <stdio.h>
+
+#include "gperl_xsubs.h"
+
+static int
+usage (void)
+{
+	fprintf (stderr, "gperlxsubs compile SOURCE INDEX\n"
+	                 "gperlxsubs query INDEX Package::sub ...\n");
+	return 2;
+}
+
+int
+main (int argc, char ** argv)
+{
+	GError * error = NULL;
+
+	if (argc >= 4 && g_str_equal (argv[1], "compile")) {
+		GPerlXSubIndex * index;
+
+		if (!perl_xsub_index_compile (argv[2], argv[3], &error)) {
+			fprintf (stderr, "%s\n", error->message);
+			g_error_free (error);
+			return 1;
+		}
+		index = perl_xsub_index_open (argv[3], &error);
+		if (!index) {
+			fprintf (stderr, "%s\n", error->message);
+			g_error_free (error);
+			return 1;
+		}
+		printf ("%u subs in %u packages\n",
+		        perl_xsub_index_get_n_subs (index),
+		        perl_xsub_index_get_n_packages (index));
+		perl_xsub_index_close (index);
+		return 0;
+	}
+
+	if (argc >= 4 && g_str_equal (argv[1], "query")) {
+		GPerlXSubIndex * index;
+		int i, status = 0;
+
+		index = perl_xsub_index_open (argv[2], &error);
+		if (!index) {
+			fprintf (stderr, "%s\n", error->message);
+			g_error_free (error);
+			return 1;
+		}
+		for (i = 3 ; i < argc ; i++) {
+			const char * prototype;
+			if (perl_xsub_index_lookup_name (index, argv[i], &prototype)) {
+				if (prototype)
+					printf ("%s(%s)\n", argv[i], prototype);
+				else
+					printf ("%s (none)\n", argv[i]);
+			} else {
+				printf ("%s not found\n", argv[i]);
+				status = 1;
+			}
+		}
+		perl_xsub_index_close (index);
+		return status;
+	}
+
+	return usage ();
+}